@@ -0,0 +1,391 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "loopbackserver.h"
+#include <QtCore/QSysInfo>
+#include <QtCore/QtEndian>
+#include <QtGui/QPainter>
+#include <QtGui/QRegion>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+namespace {
+
+enum class State {
+    Version,
+    Security,
+    ClientInit,
+    Normal,
+};
+
+struct PixelFormat
+{
+    quint8 bitsPerPixel = 32;
+    quint8 depth = 24;
+    bool bigEndian = false;
+    bool trueColor = true;
+    quint16 redMax = 255;
+    quint16 greenMax = 255;
+    quint16 blueMax = 255;
+    quint8 redShift = 16;
+    quint8 greenShift = 8;
+    quint8 blueShift = 0;
+
+    bool isNative32() const
+    {
+        return bitsPerPixel == 32 && !bigEndian && trueColor
+            && redMax == 255 && greenMax == 255 && blueMax == 255
+            && redShift == 16 && greenShift == 8 && blueShift == 0;
+    }
+};
+
+void appendU8(QByteArray &data, quint8 value)
+{
+    data.append(static_cast<char>(value));
+}
+
+void appendU16(QByteArray &data, quint16 value)
+{
+    const quint16 be = qToBigEndian(value);
+    data.append(reinterpret_cast<const char *>(&be), 2);
+}
+
+void appendU32(QByteArray &data, quint32 value)
+{
+    const quint32 be = qToBigEndian(value);
+    data.append(reinterpret_cast<const char *>(&be), 4);
+}
+
+quint16 readU16(const QByteArray &data, int offset)
+{
+    return qFromBigEndian<quint16>(data.constData() + offset);
+}
+
+quint32 readU32(const QByteArray &data, int offset)
+{
+    return qFromBigEndian<quint32>(data.constData() + offset);
+}
+
+} // namespace
+
+class LoopbackServer::Private
+{
+public:
+    Private(LoopbackServer *parent, const QSize &size);
+
+    void accept();
+    void read();
+    bool processMessage();
+    void sendRect(QByteArray &data, const QRect &rect) const;
+    void sendUpdate(const QRegion &region);
+    void flush();
+
+private:
+    LoopbackServer *q;
+
+public:
+    QTcpServer server;
+    QTcpSocket *client = nullptr;
+    QImage image;
+    State state = State::Version;
+    QByteArray buffer;
+    PixelFormat format;
+    QRegion damage;
+    bool pendingRequest = false;
+    QRect pendingRect;
+    qint64 bytesSent = 0;
+};
+
+LoopbackServer::Private::Private(LoopbackServer *parent, const QSize &size)
+    : q(parent)
+    , image(size, QImage::Format_RGB32)
+{
+    image.fill(Qt::black);
+    QObject::connect(&server, &QTcpServer::newConnection, q, [this]() {
+        accept();
+    });
+}
+
+void LoopbackServer::Private::accept()
+{
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        // Only one client at a time; a reconnect replaces the previous one.
+        if (client) {
+            client->disconnect(q);
+            client->abort();
+            client->deleteLater();
+        }
+        client = socket;
+        client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        state = State::Version;
+        buffer.clear();
+        format = PixelFormat();
+        damage = QRegion();
+        pendingRequest = false;
+
+        QObject::connect(client, &QTcpSocket::readyRead, q, [this]() {
+            read();
+        });
+        QObject::connect(client, &QTcpSocket::disconnected, q, [this, socket]() {
+            if (client == socket) {
+                client->deleteLater();
+                client = nullptr;
+            }
+        });
+
+        client->write("RFB 003.008\n");
+    }
+}
+
+void LoopbackServer::Private::read()
+{
+    buffer.append(client->readAll());
+    while (client && processMessage()) {
+    }
+}
+
+bool LoopbackServer::Private::processMessage()
+{
+    switch (state) {
+    case State::Version:
+        if (buffer.size() < 12)
+            return false;
+        buffer.remove(0, 12);
+        // One security type: None
+        client->write(QByteArray("\x01\x01", 2));
+        state = State::Security;
+        return true;
+    case State::Security: {
+        if (buffer.size() < 1)
+            return false;
+        buffer.remove(0, 1);
+        QByteArray result;
+        appendU32(result, 0);
+        client->write(result);
+        state = State::ClientInit;
+        return true;
+    }
+    case State::ClientInit: {
+        if (buffer.size() < 1)
+            return false;
+        buffer.remove(0, 1);
+        const QByteArray name("mcp-vnc-benchmark");
+        QByteArray init;
+        appendU16(init, image.width());
+        appendU16(init, image.height());
+        appendU8(init, format.bitsPerPixel);
+        appendU8(init, format.depth);
+        appendU8(init, format.bigEndian ? 1 : 0);
+        appendU8(init, format.trueColor ? 1 : 0);
+        appendU16(init, format.redMax);
+        appendU16(init, format.greenMax);
+        appendU16(init, format.blueMax);
+        appendU8(init, format.redShift);
+        appendU8(init, format.greenShift);
+        appendU8(init, format.blueShift);
+        init.append(3, '\0');
+        appendU32(init, name.size());
+        init.append(name);
+        client->write(init);
+        state = State::Normal;
+        return true;
+    }
+    case State::Normal:
+        break;
+    }
+
+    if (buffer.isEmpty())
+        return false;
+
+    const quint8 type = static_cast<quint8>(buffer.at(0));
+    switch (type) {
+    case 0: // SetPixelFormat
+        if (buffer.size() < 20)
+            return false;
+        format.bitsPerPixel = static_cast<quint8>(buffer.at(4));
+        format.depth = static_cast<quint8>(buffer.at(5));
+        format.bigEndian = buffer.at(6) != 0;
+        format.trueColor = buffer.at(7) != 0;
+        format.redMax = readU16(buffer, 8);
+        format.greenMax = readU16(buffer, 10);
+        format.blueMax = readU16(buffer, 12);
+        format.redShift = static_cast<quint8>(buffer.at(14));
+        format.greenShift = static_cast<quint8>(buffer.at(15));
+        format.blueShift = static_cast<quint8>(buffer.at(16));
+        buffer.remove(0, 20);
+        return true;
+    case 2: { // SetEncodings
+        if (buffer.size() < 4)
+            return false;
+        const int count = readU16(buffer, 2);
+        if (buffer.size() < 4 + count * 4)
+            return false;
+        // Raw is always acceptable, so the preference list is irrelevant here
+        buffer.remove(0, 4 + count * 4);
+        return true;
+    }
+    case 3: { // FramebufferUpdateRequest
+        if (buffer.size() < 10)
+            return false;
+        const bool incremental = buffer.at(1) != 0;
+        const QRect rect = QRect(readU16(buffer, 2), readU16(buffer, 4),
+                                 readU16(buffer, 6), readU16(buffer, 8))
+                               .intersected(image.rect());
+        buffer.remove(0, 10);
+        if (!incremental) {
+            damage -= rect;
+            sendUpdate(QRegion(rect));
+        } else {
+            pendingRequest = true;
+            pendingRect = rect;
+            flush();
+        }
+        return true;
+    }
+    case 4: { // KeyEvent
+        if (buffer.size() < 8)
+            return false;
+        const bool down = buffer.at(1) != 0;
+        const quint32 keysym = readU32(buffer, 4);
+        buffer.remove(0, 8);
+        emit q->keyEvent(keysym, down);
+        return true;
+    }
+    case 5: { // PointerEvent
+        if (buffer.size() < 6)
+            return false;
+        const int buttons = static_cast<quint8>(buffer.at(1));
+        const int x = readU16(buffer, 2);
+        const int y = readU16(buffer, 4);
+        buffer.remove(0, 6);
+        emit q->pointerEvent(x, y, buttons);
+        return true;
+    }
+    case 6: { // ClientCutText (negative length = Extended Clipboard)
+        if (buffer.size() < 8)
+            return false;
+        const qint32 length = qAbs(static_cast<qint32>(readU32(buffer, 4)));
+        if (buffer.size() < 8 + length)
+            return false;
+        buffer.remove(0, 8 + length);
+        return true;
+    }
+    case 150: // EnableContinuousUpdates (not advertised, ignored)
+        if (buffer.size() < 10)
+            return false;
+        buffer.remove(0, 10);
+        return true;
+    case 248: { // ClientFence (not advertised, ignored)
+        if (buffer.size() < 9)
+            return false;
+        const int length = static_cast<quint8>(buffer.at(8));
+        if (buffer.size() < 9 + length)
+            return false;
+        buffer.remove(0, 9 + length);
+        return true;
+    }
+    default:
+        qWarning("LoopbackServer: unsupported client message type %d", type);
+        client->abort();
+        return false;
+    }
+}
+
+void LoopbackServer::Private::sendRect(QByteArray &data, const QRect &rect) const
+{
+    appendU16(data, rect.x());
+    appendU16(data, rect.y());
+    appendU16(data, rect.width());
+    appendU16(data, rect.height());
+    appendU32(data, 0); // Raw
+
+    if (format.isNative32() && QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            const uchar *line = image.constScanLine(y) + rect.x() * 4;
+            data.append(reinterpret_cast<const char *>(line), rect.width() * 4);
+        }
+        return;
+    }
+
+    const int bytesPerPixel = format.bitsPerPixel / 8;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            const QRgb rgb = line[x];
+            const quint32 pixel = (quint32(qRed(rgb) * format.redMax / 255) << format.redShift)
+                | (quint32(qGreen(rgb) * format.greenMax / 255) << format.greenShift)
+                | (quint32(qBlue(rgb) * format.blueMax / 255) << format.blueShift);
+            for (int i = 0; i < bytesPerPixel; ++i) {
+                const int shift = format.bigEndian ? (bytesPerPixel - 1 - i) * 8 : i * 8;
+                data.append(static_cast<char>((pixel >> shift) & 0xff));
+            }
+        }
+    }
+}
+
+void LoopbackServer::Private::sendUpdate(const QRegion &region)
+{
+    if (!client)
+        return;
+    QByteArray data;
+    appendU8(data, 0); // FramebufferUpdate
+    appendU8(data, 0);
+    appendU16(data, region.rectCount());
+    for (const QRect &rect : region)
+        sendRect(data, rect);
+    bytesSent += data.size();
+    client->write(data);
+}
+
+void LoopbackServer::Private::flush()
+{
+    if (!pendingRequest)
+        return;
+    const QRegion region = damage.intersected(pendingRect);
+    if (region.isEmpty())
+        return;
+    damage -= region;
+    pendingRequest = false;
+    sendUpdate(region);
+}
+
+LoopbackServer::LoopbackServer(const QSize &size, QObject *parent)
+    : QObject(parent)
+    , d(new Private(this, size))
+{
+}
+
+LoopbackServer::~LoopbackServer() = default;
+
+bool LoopbackServer::listen()
+{
+    return d->server.listen(QHostAddress::LocalHost, 0);
+}
+
+quint16 LoopbackServer::port() const
+{
+    return d->server.serverPort();
+}
+
+QSize LoopbackServer::size() const
+{
+    return d->image.size();
+}
+
+void LoopbackServer::fillRect(const QRect &rect, const QColor &color)
+{
+    const QRect clipped = rect.intersected(d->image.rect());
+    if (clipped.isEmpty())
+        return;
+    QPainter painter(&d->image);
+    painter.fillRect(clipped, color);
+    painter.end();
+    d->damage += clipped;
+    d->flush();
+}
+
+qint64 LoopbackServer::bytesSent() const
+{
+    return d->bytesSent;
+}
@@ -0,0 +1,41 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef LOOPBACKSERVER_H
+#define LOOPBACKSERVER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+// Minimal RFB 3.8 server (no authentication, Raw encoding only) serving an
+// in-memory framebuffer on 127.0.0.1. Used by the benchmark to drive Tools
+// against a target whose timing is fully under our control.
+class LoopbackServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LoopbackServer(const QSize &size, QObject *parent = nullptr);
+    ~LoopbackServer() override;
+
+    bool listen();
+    quint16 port() const;
+    QSize size() const;
+
+    // Paints into the served framebuffer and pushes the damage to the client
+    // if it has an incremental update request outstanding.
+    void fillRect(const QRect &rect, const QColor &color);
+
+    qint64 bytesSent() const;
+
+signals:
+    void pointerEvent(int x, int y, int buttons);
+    void keyEvent(quint32 keysym, bool down);
+
+private:
+    class Private;
+    QScopedPointer<Private> d;
+};
+
+#endif // LOOPBACKSERVER_H
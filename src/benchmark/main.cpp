@@ -0,0 +1,373 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtGui/QGuiApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTimer>
+#include <QtCore/QtMath>
+#include <QtVncClient/QVncClient>
+#include <algorithm>
+#include "loopbackserver.h"
+#include "tools.h"
+
+using namespace Qt::Literals::StringLiterals;
+
+namespace {
+
+constexpr int operationTimeout = 10000;
+
+// Spins the event loop until the future finishes or the timeout expires.
+template <typename T>
+bool waitFor(const QFuture<T> &future, int timeout = operationTimeout)
+{
+    if (future.isFinished())
+        return true;
+    QEventLoop loop;
+    QFutureWatcher<T> watcher;
+    QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+    loop.exec();
+    return future.isFinished();
+}
+
+// Lets queued socket traffic settle between measurements.
+void settle(int msec = 20)
+{
+    QEventLoop loop;
+    QTimer::singleShot(msec, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+class Samples
+{
+public:
+    void add(qint64 nsecs) { m_values.append(nsecs / 1e6); }
+    void fail() { ++m_failures; }
+
+    QJsonObject toJson() const
+    {
+        QJsonObject obj;
+        obj["unit"_L1] = "ms"_L1;
+        obj["samples"_L1] = m_values.size();
+        obj["failures"_L1] = m_failures;
+        if (m_values.isEmpty())
+            return obj;
+        QList<double> sorted = m_values;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0;
+        for (double v : sorted)
+            sum += v;
+        const auto percentile = [&sorted](double p) {
+            const qsizetype index = qBound<qsizetype>(0, qCeil(p * sorted.size()) - 1, sorted.size() - 1);
+            return sorted.at(index);
+        };
+        obj["min"_L1] = sorted.first();
+        obj["median"_L1] = percentile(0.5);
+        obj["p95"_L1] = percentile(0.95);
+        obj["max"_L1] = sorted.last();
+        obj["mean"_L1] = sum / sorted.size();
+        return obj;
+    }
+
+private:
+    QList<double> m_values;
+    int m_failures = 0;
+};
+
+class Benchmark
+{
+public:
+    Benchmark(const QSize &size, int iterations)
+        : m_server(size)
+        , m_iterations(iterations)
+    {
+    }
+
+    QJsonObject run();
+
+private:
+    bool connectTools();
+    void disconnectTools();
+    void touch();
+    void measureConnect();
+    void measureScreenshot(bool warm);
+    void measureCheckPixelColor(bool warm);
+    void measureWaitForColor();
+    void measureInputRoundTrip();
+    void measureMacroPlayback();
+
+    LoopbackServer m_server;
+    Tools m_tools;
+    int m_iterations;
+    int m_tick = 0;
+    QJsonObject m_metrics;
+};
+
+bool Benchmark::connectTools()
+{
+    auto future = m_tools.connect("127.0.0.1"_L1, m_server.port(), {}, {}, operationTimeout);
+    if (!waitFor(future))
+        return false;
+    return m_tools.status().startsWith("connected"_L1);
+}
+
+void Benchmark::disconnectTools()
+{
+    QEventLoop loop;
+    auto conn = QObject::connect(&m_tools, &Tools::disconnected, &loop, &QEventLoop::quit);
+    QTimer::singleShot(operationTimeout, &loop, &QEventLoop::quit);
+    m_tools.disconnect();
+    if (m_tools.status() != "disconnected"_L1)
+        loop.exec();
+    QObject::disconnect(conn);
+    settle();
+}
+
+// Simulates a live target: a single changing pixel guarantees that an
+// incremental update request is answered.
+void Benchmark::touch()
+{
+    m_server.fillRect(QRect(0, 0, 1, 1), (++m_tick % 2) ? Qt::darkGray : Qt::black);
+}
+
+void Benchmark::measureConnect()
+{
+    Samples samples;
+    for (int i = 0; i < m_iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        if (connectTools())
+            samples.add(timer.nsecsElapsed());
+        else
+            samples.fail();
+        disconnectTools();
+    }
+    m_metrics["connect"_L1] = samples.toJson();
+}
+
+void Benchmark::measureScreenshot(bool warm)
+{
+    Samples samples;
+    m_tools.setPreview(warm);
+    settle();
+    for (int i = 0; i < m_iterations; ++i) {
+        touch();
+        QElapsedTimer timer;
+        timer.start();
+        auto future = m_tools.screenshot();
+        if (waitFor(future) && !future.result().isEmpty())
+            samples.add(timer.nsecsElapsed());
+        else
+            samples.fail();
+        settle();
+    }
+    m_tools.setPreview(false);
+    m_metrics[warm ? "screenshotWarm"_L1 : "screenshotCold"_L1] = samples.toJson();
+}
+
+void Benchmark::measureCheckPixelColor(bool warm)
+{
+    Samples samples;
+    m_tools.setPreview(warm);
+    settle();
+    for (int i = 0; i < m_iterations; ++i) {
+        touch();
+        QElapsedTimer timer;
+        timer.start();
+        auto future = m_tools.checkPixelColor(m_server.size().width() / 2, m_server.size().height() / 2, "#000000"_L1);
+        if (waitFor(future))
+            samples.add(timer.nsecsElapsed());
+        else
+            samples.fail();
+        settle();
+    }
+    m_tools.setPreview(false);
+    m_metrics[warm ? "checkPixelColorWarm"_L1 : "checkPixelColorCold"_L1] = samples.toJson();
+}
+
+// Time from the pixel changing on the server to waitForColor returning.
+void Benchmark::measureWaitForColor()
+{
+    Samples samples;
+    const QRect target(10, 10, 4, 4);
+    for (int i = 0; i < m_iterations; ++i) {
+        m_server.fillRect(target, Qt::black);
+        settle();
+        auto future = m_tools.waitForColor(target.x(), target.y(), "#ff0000"_L1, operationTimeout);
+        QElapsedTimer timer;
+        QObject context;
+        QTimer::singleShot(50, &context, [this, &timer, target]() {
+            timer.start();
+            m_server.fillRect(target, Qt::red);
+        });
+        if (waitFor(future, operationTimeout + 1000) && timer.isValid())
+            samples.add(timer.nsecsElapsed());
+        else
+            samples.fail();
+    }
+    m_server.fillRect(target, Qt::black);
+    m_metrics["waitForColorDetection"_L1] = samples.toJson();
+}
+
+// Time from mouseClick to the server's visual response reaching the client
+// framebuffer, with updates enabled as during a live preview.
+void Benchmark::measureInputRoundTrip()
+{
+    Samples samples;
+    const QRect target(m_server.size().width() / 2 - 20, m_server.size().height() / 2 - 20, 40, 40);
+    bool pressed = false;
+    auto serverConn = QObject::connect(&m_server, &LoopbackServer::pointerEvent, &m_server,
+        [this, &pressed, target](int, int, int buttons) {
+            const bool down = buttons & 1;
+            if (down && !pressed)
+                m_server.fillRect(target, (m_tick++ % 2) ? Qt::blue : Qt::green);
+            pressed = down;
+        });
+
+    m_tools.setPreview(true);
+    settle();
+    for (int i = 0; i < m_iterations; ++i) {
+        QEventLoop loop;
+        auto clientConn = QObject::connect(m_tools.client(), &QVncClient::imageChanged, &loop,
+            [&loop, target](const QRect &rect) {
+                if (rect.intersects(target))
+                    loop.quit();
+            });
+        QTimer::singleShot(operationTimeout, &loop, [&loop]() { loop.exit(1); });
+        QElapsedTimer timer;
+        timer.start();
+        m_tools.mouseClick(target.center().x(), target.center().y());
+        if (loop.exec() == 0)
+            samples.add(timer.nsecsElapsed());
+        else
+            samples.fail();
+        QObject::disconnect(clientConn);
+        settle();
+    }
+    m_tools.setPreview(false);
+    QObject::disconnect(serverConn);
+    m_metrics["inputRoundTrip"_L1] = samples.toJson();
+}
+
+// Per-step overhead of macro playback with zero configured delays.
+void Benchmark::measureMacroPlayback()
+{
+    constexpr int steps = 50;
+    Samples samples;
+    QTemporaryDir dir;
+    m_tools.setMacroDir(dir.path());
+    m_tools.createMacro("bench"_L1);
+    for (int i = 0; i < steps; ++i)
+        m_tools.addMacroStep("bench"_L1, "mouseMove"_L1, QStringLiteral("{\"x\":%1,\"y\":%1}").arg(i));
+
+    for (int i = 0; i < m_iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        auto future = m_tools.playMacro("bench"_L1);
+        if (waitFor(future))
+            samples.add(timer.nsecsElapsed() / steps);
+        else
+            samples.fail();
+    }
+    m_metrics["macroStepOverhead"_L1] = samples.toJson();
+}
+
+QJsonObject Benchmark::run()
+{
+    QJsonObject result;
+    result["width"_L1] = m_server.size().width();
+    result["height"_L1] = m_server.size().height();
+    if (!m_server.listen()) {
+        result["error"_L1] = "failed to listen on loopback"_L1;
+        return result;
+    }
+
+    measureConnect();
+    if (!connectTools()) {
+        result["error"_L1] = "failed to connect to loopback server"_L1;
+        result["metrics"_L1] = m_metrics;
+        return result;
+    }
+    measureScreenshot(false);
+    measureScreenshot(true);
+    measureCheckPixelColor(false);
+    measureCheckPixelColor(true);
+    measureWaitForColor();
+    measureInputRoundTrip();
+    measureMacroPlayback();
+    disconnectTools();
+
+    result["serverBytesSent"_L1] = m_server.bytesSent();
+    result["metrics"_L1] = m_metrics;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("mcp-vnc-benchmark");
+    app.setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end latency benchmark for mcp-vnc tools against a loopback RFB server"_L1);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption iterationsOption("iterations"_L1, "Samples per metric (default: 20)."_L1, "count"_L1, "20"_L1);
+    QCommandLineOption resolutionsOption("resolutions"_L1,
+        "Comma-separated list of framebuffer sizes (default: 800x480,1280x720,1920x1080,3840x2160)."_L1,
+        "list"_L1, "800x480,1280x720,1920x1080,3840x2160"_L1);
+    QCommandLineOption outputOption({"o"_L1, "output"_L1}, "Write JSON results to a file instead of stdout."_L1, "file"_L1);
+    parser.addOptions({iterationsOption, resolutionsOption, outputOption});
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    QJsonArray runs;
+    const auto resolutions = parser.value(resolutionsOption).split(u',', Qt::SkipEmptyParts);
+    for (const QString &resolution : resolutions) {
+        const auto parts = resolution.trimmed().split(u'x');
+        const QSize size = parts.size() == 2 ? QSize(parts.at(0).toInt(), parts.at(1).toInt()) : QSize();
+        if (size.isEmpty() || size.width() > 0xffff || size.height() > 0xffff) {
+            qWarning("Skipping invalid resolution '%s'", qPrintable(resolution));
+            continue;
+        }
+        Benchmark benchmark(size, iterations);
+        runs.append(benchmark.run());
+    }
+
+    QJsonObject root;
+    root["benchmark"_L1] = "mcp-vnc"_L1;
+    root["iterations"_L1] = iterations;
+    root["qtVersion"_L1] = QString::fromLatin1(qVersion());
+    root["runs"_L1] = runs;
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning("Cannot write %s", qPrintable(file.fileName()));
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QFile out;
+        if (!out.open(stdout, QIODevice::WriteOnly))
+            return 1;
+        out.write(json);
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "imagediff.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtGui/QRegion>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <numeric>
+
+namespace {
+
+struct Cell
+{
+    qint64 pixels = 0;
+    int left = INT_MAX;
+    int top = INT_MAX;
+    int right = -1;
+    int bottom = -1;
+};
+
+// Largest channel difference per pixel, 0-255. Both rows are RGB32, so the
+// fourth byte is always 0xff and drops out.
+void channelDifference(const uchar *a, const uchar *b, uchar *out, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const int d0 = std::abs(int(a[4 * x]) - int(b[4 * x]));
+        const int d1 = std::abs(int(a[4 * x + 1]) - int(b[4 * x + 1]));
+        const int d2 = std::abs(int(a[4 * x + 2]) - int(b[4 * x + 2]));
+        out[x] = uchar(std::max(d0, std::max(d1, d2)));
+    }
+}
+
+} // namespace
+
+ImageDiff ImageDiff::compare(const QImage &actualImage, const QImage &expectedImage, int tolerance,
+                             const QList<QRect> &ignore, QImage *heatMap)
+{
+    ImageDiff result;
+    const QImage actual = actualImage.convertToFormat(QImage::Format_RGB32);
+    const QImage expected = expectedImage.convertToFormat(QImage::Format_RGB32);
+    const int width = actual.width();
+    const int height = actual.height();
+    if (actual.isNull() || actual.size() != expected.size())
+        return result;
+
+    QRegion ignored;
+    for (const QRect &rect : ignore)
+        ignored += rect & actual.rect();
+    // Detached here: tasks write their own scanlines through the raw pointer
+    uchar *heatBits = nullptr;
+    qsizetype heatStride = 0;
+    if (heatMap) {
+        *heatMap = QImage(actual.size(), QImage::Format_RGB32);
+        heatBits = heatMap->bits();
+        heatStride = heatMap->bytesPerLine();
+    }
+
+    const int columns = (width + Tile - 1) / Tile;
+    const int rows = (height + Tile - 1) / Tile;
+    QList<Cell> cells(qsizetype(columns) * rows);
+    QList<int> bands(rows);
+    std::iota(bands.begin(), bands.end(), 0);
+    // Detached here too, so tasks never reach the list's copy-on-write path
+    Cell *cellBits = cells.data();
+
+    // Each task owns one band of rows and its row of cells, so nothing is shared
+    QtConcurrent::blockingMap(bands, [&](int band) {
+        QList<uchar> diff(width);
+        Cell *cellRow = cellBits + qsizetype(band) * columns;
+        const int top = band * Tile;
+        const int bottom = qMin(top + Tile, height);
+        for (int y = top; y < bottom; ++y) {
+            channelDifference(actual.constScanLine(y), expected.constScanLine(y), diff.data(), width);
+            for (const QRect &rect : ignored) {
+                if (y >= rect.top() && y <= rect.bottom())
+                    std::fill_n(diff.data() + rect.left(), rect.width(), uchar(0));
+            }
+
+            if (heatBits) {
+                const QRgb *source = reinterpret_cast<const QRgb *>(actual.constScanLine(y));
+                QRgb *target = reinterpret_cast<QRgb *>(heatBits + y * heatStride);
+                for (int x = 0; x < width; ++x) {
+                    const int gray = qGray(source[x]) / 3;
+                    target[x] = diff[x] > tolerance ? qRgb(128 + diff[x] / 2, gray, gray) : qRgb(gray, gray, gray);
+                }
+            }
+
+            for (int column = 0; column < columns; ++column) {
+                const int left = column * Tile;
+                const int right = qMin(left + Tile, width);
+                int count = 0;
+                int first = right;
+                int last = -1;
+                for (int x = left; x < right; ++x) {
+                    const bool differs = diff[x] > tolerance;
+                    count += differs;
+                    if (differs) {
+                        first = qMin(first, x);
+                        last = x;
+                    }
+                }
+                if (count == 0)
+                    continue;
+                Cell &cell = cellRow[column];
+                cell.pixels += count;
+                cell.left = qMin(cell.left, first);
+                cell.right = qMax(cell.right, last);
+                cell.top = qMin(cell.top, y);
+                cell.bottom = y;
+            }
+        }
+    });
+
+    qint64 ignoredPixels = 0;
+    for (const QRect &rect : ignored)
+        ignoredPixels += qint64(rect.width()) * rect.height();
+    result.comparedPixels = qint64(width) * height - ignoredPixels;
+
+    // Group touching cells into areas
+    QList<bool> visited(cells.size(), false);
+    QList<qsizetype> stack;
+    for (qsizetype start = 0; start < cells.size(); ++start) {
+        if (visited[start] || cells[start].pixels == 0)
+            continue;
+        Area area { QRect(), 0 };
+        stack.append(start);
+        visited[start] = true;
+        while (!stack.isEmpty()) {
+            const qsizetype index = stack.takeLast();
+            const Cell &cell = cells[index];
+            area.pixels += cell.pixels;
+            area.rect |= QRect(QPoint(cell.left, cell.top), QPoint(cell.right, cell.bottom));
+            const int column = int(index % columns);
+            const int row = int(index / columns);
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int c = column + dx;
+                    const int r = row + dy;
+                    if (c < 0 || c >= columns || r < 0 || r >= rows)
+                        continue;
+                    const qsizetype neighbor = qsizetype(r) * columns + c;
+                    if (!visited[neighbor] && cells[neighbor].pixels > 0) {
+                        visited[neighbor] = true;
+                        stack.append(neighbor);
+                    }
+                }
+            }
+        }
+        result.differingPixels += area.pixels;
+        result.areas.append(area);
+    }
+    std::sort(result.areas.begin(), result.areas.end(), [](const Area &a, const Area &b) {
+        return a.pixels > b.pixels;
+    });
+    return result;
+}
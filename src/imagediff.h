@@ -0,0 +1,37 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <QtCore/QList>
+#include <QtCore/QRect>
+#include <QtGui/QImage>
+
+// Per-pixel comparison of two equally sized frames. A pixel differs when any
+// color channel differs by more than the tolerance. Rows are compared in
+// parallel, one band of Tile rows per task, and the inner loops are plain
+// byte arithmetic the compiler vectorizes. Differing pixels are gathered
+// into Tile x Tile cells whose 8-connected groups become the reported areas.
+struct ImageDiff
+{
+    struct Area
+    {
+        QRect rect;
+        qint64 pixels;
+    };
+
+    qint64 comparedPixels = 0;
+    qint64 differingPixels = 0;
+    QList<Area> areas;
+
+    // heatMap, when given, receives the actual frame dimmed to gray with
+    // differing pixels in red, brighter for larger differences
+    static ImageDiff compare(const QImage &actual, const QImage &expected, int tolerance,
+                             const QList<QRect> &ignore, QImage *heatMap = nullptr);
+
+private:
+    static constexpr int Tile = 32;
+};
+
+#endif // IMAGEDIFF_H
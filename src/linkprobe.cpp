@@ -0,0 +1,138 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "linkprobe.h"
+
+static double smooth(double average, double sample, int samples)
+{
+    return samples == 0 ? sample : average + (sample - average) / 8.0;
+}
+
+void LinkProbe::reset()
+{
+    *this = LinkProbe();
+}
+
+void LinkProbe::addRttSample(qint64 nsecs)
+{
+    m_rttMs = smooth(m_rttMs, nsecs / 1e6, m_rttSamples);
+    ++m_rttSamples;
+}
+
+void LinkProbe::addUpdateLatencySample(qint64 nsecs)
+{
+    const double ms = nsecs / 1e6;
+    m_updateLatencyMs = smooth(m_updateLatencyMs, ms, m_updateSamples);
+    m_minUpdateLatencyMs = m_updateSamples == 0 ? ms : qMin(m_minUpdateLatencyMs, ms);
+    ++m_updateSamples;
+}
+
+void LinkProbe::addTransferSample(qint64 bytes, qint64 nsecs)
+{
+    // Anything faster than the clock resolution is not a useful sample
+    if (bytes <= 0 || nsecs < 100000)
+        return;
+    m_bandwidth = smooth(m_bandwidth, bytes * 1e9 / nsecs, m_transferSamples);
+    ++m_transferSamples;
+}
+
+double LinkProbe::rttMs() const
+{
+    // A request/update round trip can never beat the RTT, so the fastest one
+    // bounds it from above when the handshake sample is stale or missing.
+    if (m_rttSamples > 0 && m_updateSamples > 0)
+        return qMin(m_rttMs, m_minUpdateLatencyMs);
+    if (m_rttSamples > 0)
+        return m_rttMs;
+    return m_minUpdateLatencyMs;
+}
+
+LinkProbe::Profile LinkProbe::profile() const
+{
+    if (m_rttSamples == 0 && m_updateSamples == 0)
+        return Profile::Unknown;
+    const double rtt = rttMs();
+    const bool knownBandwidth = m_transferSamples > 0;
+    if (rtt < 1.0 && (!knownBandwidth || m_bandwidth > 50e6))
+        return Profile::Local;
+    if (rtt < 20.0 && (!knownBandwidth || m_bandwidth > 2e6))
+        return Profile::Lan;
+    return Profile::Wan;
+}
+
+QString LinkProbe::profileName() const
+{
+    switch (profile()) {
+    case Profile::Local:
+        return QStringLiteral("local");
+    case Profile::Lan:
+        return QStringLiteral("lan");
+    case Profile::Wan:
+        return QStringLiteral("wan");
+    case Profile::Unknown:
+        break;
+    }
+    return QStringLiteral("unknown");
+}
+
+int LinkProbe::pollInterval() const
+{
+    switch (profile()) {
+    case Profile::Local:
+        return 100;
+    case Profile::Lan:
+        return 250;
+    case Profile::Wan:
+    case Profile::Unknown:
+        break;
+    }
+    return 1000;
+}
+
+// Slow links take longer to render and deliver the reaction to an input
+int LinkProbe::inputBurstWindow() const
+{
+    switch (profile()) {
+    case Profile::Local:
+        return 1000;
+    case Profile::Lan:
+        return 2000;
+    case Profile::Wan:
+    case Profile::Unknown:
+        break;
+    }
+    return 3000;
+}
+
+// Extra update requests kept in flight: only worth it when the round trip,
+// not the server, limits the update rate
+int LinkProbe::requestPipelineDepth() const
+{
+    return profile() == Profile::Wan ? 1 : 0;
+}
+
+QString LinkProbe::summary() const
+{
+    if (profile() == Profile::Unknown)
+        return QStringLiteral("link: not measured yet");
+    QString text = QStringLiteral("link: %1, rtt %2 ms").arg(profileName()).arg(rttMs(), 0, 'f', 1);
+    if (m_transferSamples > 0)
+        text += QStringLiteral(", downstream %1 MB/s").arg(m_bandwidth / 1e6, 0, 'f', 1);
+    return text;
+}
+
+QJsonObject LinkProbe::toJson() const
+{
+    QJsonObject obj;
+    obj[QStringLiteral("profile")] = profileName();
+    if (m_rttSamples > 0 || m_updateSamples > 0)
+        obj[QStringLiteral("rttMs")] = rttMs();
+    if (m_updateSamples > 0)
+        obj[QStringLiteral("updateLatencyMs")] = m_updateLatencyMs;
+    if (m_transferSamples > 0)
+        obj[QStringLiteral("downstreamBytesPerSecond")] = m_bandwidth;
+    obj[QStringLiteral("pollIntervalMs")] = pollInterval();
+    obj[QStringLiteral("inputBurstWindowMs")] = inputBurstWindow();
+    obj[QStringLiteral("requestPipelineDepth")] = requestPipelineDepth();
+    return obj;
+}
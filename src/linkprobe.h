@@ -0,0 +1,56 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef LINKPROBE_H
+#define LINKPROBE_H
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+// Passive link quality estimator. RTT comes from the TCP handshake and from
+// the fastest request-to-update round trips; downstream bandwidth from the
+// bytes and arrival time of each framebuffer update. Both are smoothed like
+// TCP's SRTT (alpha = 1/8).
+class LinkProbe
+{
+public:
+    enum class Profile {
+        Unknown,
+        Local,  // loopback or same host: sub-millisecond, hundreds of MB/s
+        Lan,
+        Wan,    // cellular, VPN or long-haul links
+    };
+
+    void reset();
+
+    void addRttSample(qint64 nsecs);
+    void addUpdateLatencySample(qint64 nsecs);
+    void addTransferSample(qint64 bytes, qint64 nsecs);
+
+    bool hasRtt() const { return m_rttSamples > 0; }
+    double rttMs() const;
+    double updateLatencyMs() const { return m_updateLatencyMs; }
+    double bandwidth() const { return m_bandwidth; }
+
+    Profile profile() const;
+    QString profileName() const;
+
+    // Defaults derived from the profile
+    int pollInterval() const;
+    int inputBurstWindow() const;
+    int requestPipelineDepth() const;
+
+    QString summary() const;
+    QJsonObject toJson() const;
+
+private:
+    double m_rttMs = 0;
+    double m_minUpdateLatencyMs = 0;
+    double m_updateLatencyMs = 0;
+    double m_bandwidth = 0; // bytes per second
+    int m_rttSamples = 0;
+    int m_updateSamples = 0;
+    int m_transferSamples = 0;
+};
+
+#endif // LINKPROBE_H
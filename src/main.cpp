@@ -6,7 +6,11 @@
 Q_IMPORT_PLUGIN(QMcpServerStdioPlugin)
 #endif
 
+#ifdef HAVE_WIDGETS
 #include <QtWidgets/QApplication>
+#endif
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtMcpServer/QMcpServer>
@@ -16,12 +20,15 @@ Q_IMPORT_PLUGIN(QMcpServerStdioPlugin)
 #include <QtMcpCommon/QMcpPromptMessage>
 #include <QtMcpCommon/QMcpServerCapabilities>
 #include <QtMcpCommon/QMcpTextContent>
+#include <algorithm>
+#include <memory>
 #include <unistd.h>
 #include "tools.h"
-#include "vncwidget.h"
+#include "trace.h"
 
 namespace {
 
+#ifdef HAVE_WIDGETS
 // MCP clients (e.g. codex) often spawn the server with display env vars stripped.
 // Probe the local session for a usable Wayland or X11 socket and set the matching
 // env vars so the optional preview window still works. Returns false if nothing
@@ -64,53 +71,124 @@ bool detectDisplayEnv()
     }
     return false;
 }
+#endif
 
 } // namespace
 
 int main(int argc, char *argv[])
 {
-    // MCP clients such as codex strip display env vars before spawning the
-    // server, so Qt's default xcb plugin aborts before initialize can be
-    // answered and the client reports a startup timeout. Auto-detect a local
-    // Wayland or X11 session so the preview window keeps working; fall back
-    // to the offscreen platform only when no display is available.
-    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
-        && qEnvironmentVariableIsEmpty("DISPLAY")
-        && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")
-        && !detectDisplayEnv()) {
-        qputenv("QT_QPA_PLATFORM", "offscreen");
+    // Headless runs (--headless, or builds without QtWidgets) use a plain
+    // QCoreApplication: no platform plugin, display connection or widget
+    // state is loaded, and the preview is unavailable. The flag has to be
+    // seen before the application object exists, so argv is scanned here.
+    std::unique_ptr<QCoreApplication> application;
+#ifdef HAVE_WIDGETS
+    const bool headless = std::any_of(argv + 1, argv + argc, [](const char *arg) {
+        return qstrcmp(arg, "--headless") == 0;
+    });
+    if (!headless) {
+        // MCP clients such as codex strip display env vars before spawning the
+        // server, so Qt's default xcb plugin aborts before initialize can be
+        // answered and the client reports a startup timeout. Auto-detect a local
+        // Wayland or X11 session so the preview window keeps working; fall back
+        // to the offscreen platform only when no display is available.
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
+            && qEnvironmentVariableIsEmpty("DISPLAY")
+            && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")
+            && !detectDisplayEnv()) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        auto *gui = new QApplication(argc, argv);
+        gui->setQuitOnLastWindowClosed(false);
+        application.reset(gui);
     }
-
-    QApplication app(argc, argv);
+#endif
+    if (!application)
+        application = std::make_unique<QCoreApplication>(argc, argv);
+    QCoreApplication &app = *application;
     app.setApplicationName("MCP VNC Server");
     app.setApplicationVersion("1.0");
     app.setOrganizationName("Signal Slot Inc.");
     app.setOrganizationDomain("signal-slot.co.jp");
-    app.setQuitOnLastWindowClosed(false);
 
-    QMcpServer server("stdio"_L1);
+    // A network transport lets several MCP clients share one long-lived
+    // process, and with it one VNC connection and framebuffer stream
+    QCommandLineParser parser;
+    parser.setApplicationDescription("MCP server for controlling VNC sessions"_L1);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption transportOption("transport"_L1,
+        "MCP transport backend: stdio (default) or sse."_L1, "backend"_L1, "stdio"_L1);
+    const QCommandLineOption listenOption("listen"_L1,
+        "Address for network transports, e.g. 127.0.0.1:8000."_L1, "address"_L1);
+    const QCommandLineOption headlessOption("headless"_L1,
+        "Run without the preview window and without connecting to a display."_L1);
+    parser.addOption(transportOption);
+    parser.addOption(listenOption);
+    parser.addOption(headlessOption);
+    parser.process(app);
+
+    // MCP_VNC_TRACE=<file> traces the whole process lifetime
+    if (qEnvironmentVariableIsSet("MCP_VNC_TRACE")) {
+        Tracer::instance()->start(qEnvironmentVariable("MCP_VNC_TRACE"));
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+            Tracer::instance()->stop();
+        });
+    }
+
+    QMcpServer server(parser.value(transportOption));
     QObject::connect(&server, &QMcpServer::finished, &app, &QCoreApplication::quit);
     auto *tools = new Tools(&server);
+    // Tool calls run synchronously as their request is handled, so the last
+    // request's session is the caller
+    QObject::connect(&server, &QMcpServer::received, tools, [tools](const QUuid &session) {
+        tools->setSession(session);
+    });
     server.registerToolSet(tools, {
-        { "connect", "Connect to a VNC server. Must be called before any other tool. Establishes a TCP connection and performs VNC handshake. Supports standard VNC password authentication and Apple Remote Desktop (ARD) username/password authentication for macOS Screen Sharing. Use status() to verify the connection succeeded." },
-        { "connect/host", "Hostname or IP address of the VNC server (e.g., \"localhost\", \"192.168.1.100\")" },
-        { "connect/port", "Port number of the VNC server (default: 5900). Standard VNC ports are 5900+N where N is the display number." },
+        { "connect", "Connect to a VNC server. Must be called before any other tool. Establishes a TCP connection and performs VNC handshake. Supports standard VNC password authentication and Apple Remote Desktop (ARD) username/password authentication for macOS Screen Sharing. Use status() to verify the connection succeeded. When the server is shared by several MCP clients, connecting to the host and port that are already connected returns the current status immediately; connecting to a different target requires disconnect first." },
+        { "connect/host", "Hostname or IP address of the VNC server (e.g., \"localhost\", \"192.168.1.100\"), or the absolute path of a Unix-domain socket the server listens on (e.g., \"/run/user/1000/wayvnc.sock\"; Linux and macOS only). Unix sockets avoid TCP loopback overhead for local servers." },
+        { "connect/port", "Port number of the VNC server (default: 5900). Standard VNC ports are 5900+N where N is the display number. Ignored for Unix-domain socket paths." },
         { "connect/password", "Password for VNC authentication (optional). Required only if the VNC server has password authentication enabled." },
         { "connect/username", "Username for Apple Remote Desktop (ARD) authentication (optional). Required only when connecting to macOS Screen Sharing or ARD servers that use username/password authentication." },
         { "connect/timeout", "Connection timeout in milliseconds (default: 30000, i.e., 30 seconds). If the VNC handshake does not complete within this time, the connection is aborted and an error is returned." },
-        { "disconnect", "Disconnect from the VNC server. Closes the TCP connection. Safe to call even if not connected." },
+        { "connect/encodings", "Comma-separated RFB encoding preference order for this connection, e.g. \"zrle,hextile\" or \"tight\" (optional; default: the client's own order). Known encodings: raw, copyrect, rre, hextile, zlib, tight, zrle; those the VNC client cannot decode are ignored and named in the result. Raw is always added as a fallback." },
+        { "connect/quality", "Tight JPEG quality level 0-9 requested with the encodings (default: -1 = not requested). Lower values use less bandwidth." },
+        { "connect/compression", "zlib compression level 0-9 requested with the encodings (default: -1 = not requested). Higher values trade server CPU for bandwidth." },
+        { "disconnect", "Disconnect from the VNC server. Closes the TCP connection. Safe to call even if not connected. When the server is shared by several MCP clients, the connection stays open while other clients that connected to it still use it; then false is returned and only this client is detached." },
+        { "setEncodings", "Change the RFB encoding preference order and quality/compression levels of the current connection at runtime, e.g. fast uncompressed encodings on loopback and tight with low quality on a slow link. Returns the requested settings as JSON. VNC servers do not acknowledge the request; they pick from the list per update, and the effect is visible in getStats transfer counters." },
+        { "setEncodings/encodings", "Comma-separated encoding preference order (raw, copyrect, rre, hextile, zlib, tight, zrle). Encodings the VNC client cannot decode are rejected; getStats lists the ones it does as \"clientEncodings\". Raw is always added as a fallback." },
+        { "setEncodings/quality", "Tight JPEG quality level 0-9 (default: -1 = not requested)" },
+        { "setEncodings/compression", "zlib compression level 0-9 (default: -1 = not requested)" },
+        { "setReducedQuality", "Request lossy Tight JPEG updates while only waits, change detection or the preview consume frames, cutting bandwidth of long waitForColor and stability waits on slow links. Before a screenshot, save, checkPixelColor or snapshot, and during the input burst, the server is switched back to lossless encodings and the whole screen is refreshed, so returned pixels are always exact. waitForColor confirms near matches on lossy frames against a lossless refresh. Returns \"true\", or an error if the VNC client does not decode Tight or its encodings are unknown." },
+        { "setReducedQuality/quality", "JPEG quality 0-9 used in reduced mode, -1 to disable (the default)" },
         { "screenshot", "Capture the current VNC screen and return as a base64-encoded image. Call with no arguments to capture the full screen, or specify a region with x/y/width/height. Always take a screenshot after performing actions to verify the result. Returns an error message if not connected or the framebuffer is unavailable." },
         { "screenshot/x", "X coordinate of the top-left corner of the capture region in pixels (default: 0)" },
         { "screenshot/y", "Y coordinate of the top-left corner of the capture region in pixels (default: 0)" },
         { "screenshot/width", "Width of the capture region in pixels (default: -1 for full width from x to the right edge)" },
         { "screenshot/height", "Height of the capture region in pixels (default: -1 for full height from y to the bottom edge)" },
-        { "save", "Save the current VNC screen to an image file on disk. The image format is determined by the file extension (e.g., .png, .jpg, .bmp). Returns \"true\" on success or \"false\" on failure. Useful for archiving screenshots or when a file path is needed rather than inline image data." },
+        { "screenshot/snapshot", "Handle returned by snapshot. When given, the region is taken from that frozen frame instead of the live screen." },
+        { "save", "Save the current VNC screen to an image file on disk. The image format is determined by the file extension (e.g., .png, .jpg, .bmp). Returns \"true\" on success or \"false\" on failure (JSON while setScreenshotStore is active). Useful for archiving screenshots or when a file path is needed rather than inline image data." },
         { "save/filePath", "Absolute file path to save the screenshot (e.g., /tmp/screenshot.png). The directory must exist. Supported formats: PNG, JPG, BMP, and other Qt-supported image formats." },
         { "save/x", "X coordinate of the top-left corner of the capture region in pixels (default: 0)" },
         { "save/y", "Y coordinate of the top-left corner of the capture region in pixels (default: 0)" },
         { "save/width", "Width of the capture region in pixels (default: -1 for full width from x to the right edge)" },
         { "save/height", "Height of the capture region in pixels (default: -1 for full height from y to the bottom edge)" },
-        { "status", "Get the current VNC connection status. Returns \"connected to <host>:<port> (<width>x<height>)\" when connected (including the framebuffer resolution), or \"disconnected\" when not connected. Use this after connect() to verify the connection and to learn the screen dimensions." },
+        { "setScreenshotStore", "Turn save into a deduplicating, content-addressed archive for long-running audits. Each distinct frame is encoded once into objects/ below the directory, named by the hash of its pixels; saving an identical frame again encodes nothing and copies the stored file to filePath. As with a plain save, filePath's suffix picks its format; a suffix naming another format than the store's gets the frame encoded again. An existing file at filePath is only replaced once the new one is complete. Every save appends a line with timestamp, hash and region to index.jsonl. Hashing, encoding and writing run on a background thread. While the store is set, save returns JSON with hash, object path and whether it was a duplicate, and filePath may be empty to only archive the frame. Returns JSON describing the store, or \"true\" after turning it off." },
+        { "setScreenshotStore/directory", "Store directory, created if needed; reopening an existing store keeps its objects and index. Empty turns the store off after pending saves finish." },
+        { "setScreenshotStore/format", "Image format of stored objects, e.g. png, jpg, bmp (default: png)" },
+        { "setScreenshotStore/hardLinks", "Hard-link filePath to the stored file instead of copying it, saving disk space (default: false). Stored files are made read-only first, because editing a linked file would change every save of the same frame; falls back to copying where hard links are unsupported." },
+        { "snapshot", "Freeze the current VNC screen and return a handle for it as JSON ({\"snapshot\": handle, \"width\": ..., \"height\": ...}). Pass the handle to screenshot or checkPixelColor to inspect exactly the same frame across several calls without it changing in between. Snapshots share memory with the live framebuffer until it changes; the least recently used ones expire once they exceed 256 MB in total." },
+        { "releaseSnapshot", "Release a snapshot handle and its memory. Returns false if the handle is unknown or has already expired." },
+        { "releaseSnapshot/snapshot", "Handle returned by snapshot" },
+        { "getSharedFramebuffer", "Publish the live framebuffer into a shared memory segment for local processes (OCR, detectors) and return its name, key type and layout as JSON. The key type is posix (a shm_open name) where available, otherwise systemv (an ftok file path) or windows. Pixels are raw (no encoding) and kept current on every framebuffer update; a header holds the geometry, a frame counter, a seqlock sequence number (odd while being written, read between two equal even values) and the rectangles changed by the latest frame. The segment is recreated under a new name when the resolution changes; the old one's magic reads 0. Framebuffer updates stay enabled while sharing." },
+        { "stopSharedFramebuffer", "Stop publishing the framebuffer to shared memory and remove the segment. Returns false if it was not being shared." },
+        { "status", "Get the current VNC connection status. Returns \"connected to <host>:<port> (<width>x<height>); link: <profile>, rtt <ms> ms, downstream <MB/s> MB/s\" when connected (including the framebuffer resolution and passively measured link quality; profile is local, lan or wan), or \"disconnected\" when not connected. Use this after connect() to verify the connection and to learn the screen dimensions." },
+        { "getStats", "Get runtime statistics as a JSON object: per-tool call counts with p50/p95/p99/max latency (\"tools\"), bytes received/sent and framebuffer updates per second (\"transfer\"), framebuffer decode, cursor composite and image encode times (\"timings\"), bytes currently held by the framebuffer, cursor and clipboard buffers (\"memory\") and the passive link estimate (\"link\"). Latencies are histogram-based and accurate to about 25%." },
+        { "setStatsInterval", "Periodically push the getStats JSON to the client as an MCP logging notification (level info, logger \"mcp-vnc\"). Only the client that called it receives the reports; 0 turns them off. Useful for monitoring long-running sessions without polling." },
+        { "setStatsInterval/interval", "Notification interval in milliseconds (minimum 1000). Use 0 to stop the notifications." },
+        { "startTrace", "Start recording a Chrome trace-event timeline of tool invocations and framebuffer processing (update round trip, decode, cursor compositing, image encoding). Open the file in chrome://tracing or https://ui.perfetto.dev. Returns false if a trace is already running. The file is written by stopTrace." },
+        { "startTrace/filePath", "Absolute path of the trace JSON file to write when the trace is stopped (e.g., /tmp/mcp-vnc-trace.json)." },
+        { "stopTrace", "Stop the running trace and write it to the file given to startTrace. Returns the number of events written or an error message." },
         { "getCursorInfo", "Get the current cursor position, hotspot, and cursor image dimensions. Returns a JSON object with x, y, hotspotX, hotspotY, cursorWidth, cursorHeight. Cursor position is reported by the VNC server via pseudo-encodings; if the server does not support this, values may be zero." },
         { "mouseMove", "Move the mouse cursor to the specified position. Also updates the internal cursor position used as the starting point for dragAndDrop. Set the button parameter to simulate dragging while moving." },
         { "mouseMove/x", "Target X coordinate in pixels (0 = left edge of screen)" },
@@ -146,7 +224,11 @@ int main(int argc, char *argv[])
         { "sendKey/down", "true to press the key down, false to release it. Send both press and release for a complete keystroke. For modifier combinations (e.g., Ctrl+C), press the modifier first, press the key, release the key, then release the modifier." },
         { "sendText", "Type a string of text by sending individual key press and release events for each character. This is the simplest way to enter text into input fields, editors, or terminals. For special keys (Enter, Backspace, arrow keys, etc.) or modifier combinations (Ctrl+C, Alt+Tab), use sendKey instead." },
         { "sendText/text", "The text string to type. Each character is sent as a separate key press/release pair. Supports Unicode characters." },
-        { "setPreview", "Show or hide a live preview window that displays the VNC screen in real-time. The preview window is hidden by default. When visible, the screen is continuously updated. Useful for monitoring what's happening on the remote screen." },
+        { "setInputBurst", "Configure how long framebuffer updates stay enabled after each input action (mouse, key and text tools). During this window the server keeps the local framebuffer current, so a following screenshot, save or checkPixelColor returns immediately instead of requesting a refresh. The default follows the measured link: 1 s on local links, 2 s on LANs and 3 s on slow links." },
+        { "setInputBurst/window", "Window in milliseconds (default: -1 = follow the link profile, 0 = disable)" },
+        { "setUpdatePipelining", "Keep extra incremental framebuffer update requests in flight while updates are enabled, so the server always has a request pending and preview, recording and wait tools see frames at the server's rate instead of one per round trip. The default follows the measured link: one extra request on slow links, none on local links and LANs. This pipelines ordinary FramebufferUpdateRequests; the ContinuousUpdates extension is not negotiated." },
+        { "setUpdatePipelining/depth", "Extra requests kept in flight, 0-4 (default: -1 = follow the link profile, 0 = disable)" },
+        { "setPreview", "Show or hide a live preview window that displays the VNC screen in real-time. The preview window is hidden by default and created on first use; it is unavailable when the server runs with --headless or was built without QtWidgets. While enabled, the screen is continuously updated, with or without a window. Useful for monitoring what's happening on the remote screen." },
         { "setPreview/visible", "true to show the preview window, false to hide it" },
         { "setInteractive", "Enable or disable interactive mode on the preview window. When enabled, mouse clicks and keyboard input on the preview window are forwarded to the VNC server, allowing direct manual interaction. When disabled (default), the preview is view-only. The preview window must be visible (setPreview) for this to have any effect." },
         { "setInteractive/enabled", "true to enable interactive mode (input forwarded to VNC), false for view-only mode" },
@@ -154,6 +236,10 @@ int main(int argc, char *argv[])
         { "setStaysOnTop/enabled", "true to keep the preview window always on top, false to allow normal window stacking" },
         { "setPreviewTitle", "Set a custom title for the preview window's title bar. Useful for identifying which VNC session is being displayed when working with multiple connections." },
         { "setPreviewTitle/title", "The title text to display in the preview window's title bar" },
+        { "setPreviewFrameRate", "Cap how often the preview window repaints. Screen changes arriving between repaints are merged and drawn together, which keeps the preview cheap on large or busy screens. The default is 30 frames per second." },
+        { "setPreviewFrameRate/fps", "Maximum repaints per second (0 = repaint on every screen change)" },
+        { "setPreviewScaled", "Scale the remote screen to fit the preview window instead of sizing the window to the remote screen. The downscaled image is cached and only changed areas are rescaled. In interactive mode, pointer positions are mapped back to remote screen coordinates." },
+        { "setPreviewScaled/enabled", "true to scale the screen to the window, false to show it at its native size (default)" },
         { "setMacroDir", "Set the directory where macros are saved and loaded from. Call this before using any other macro tool. Creates the directory if it doesn't exist. Use a project-specific path to keep macros organized per project." },
         { "setMacroDir/path", "Absolute path to the macro directory (e.g., /home/user/my-project/.mcp-vnc/macros)" },
         { "createMacro", "Create a new empty macro with the given name. Returns false if the macro already exists or the macro directory is not set." },
@@ -167,6 +253,7 @@ int main(int argc, char *argv[])
         { "playMacro", "Play a saved macro by executing all its steps sequentially with their configured delays. Returns a completion message with the number of steps executed. Only one macro can play at a time." },
         { "playMacro/name", "Name of the macro to play" },
         { "playMacro/speedFactor", "Speed factor as a percentage (default: 100). Values >100 speed up playback, <100 slow it down. Minimum 1." },
+        { "cancelMacro", "Stop the macro that is currently playing. Pending steps are skipped, a running waitForColor step is abandoned and playMacro returns with the number of steps executed. Returns false if no macro is playing." },
         { "listMacros", "List all saved macros in the macro directory. Returns a list of macro names (without .json extension). Returns empty if the macro directory is not set." },
         { "getMacro", "Get the full JSON content of a macro, including name, description, and all steps. Useful for inspecting or debugging a macro." },
         { "getMacro/name", "Name of the macro to retrieve" },
@@ -177,20 +264,86 @@ int main(int argc, char *argv[])
         { "checkPixelColor/y", "Y coordinate of the pixel to check in pixels" },
         { "checkPixelColor/color", "Expected color in hex format (e.g., \"#FF0000\" for red, \"#FFFFFF\" for white)." },
         { "checkPixelColor/similarity", "Similarity threshold from 0.0 to 1.0 (default: 1.0 = exact RGB match). When < 1.0, colors are compared in HSV space. For example, 0.9 means 90% similar is considered a match." },
-        { "waitForColor", "Poll the pixel color at a specific coordinate every second until it matches the expected color, then return a full screenshot. Returns a timeout error message if the color does not match within the specified duration. When similarity < 1.0, uses HSV color space comparison for fuzzy matching." },
+        { "checkPixelColor/snapshot", "Handle returned by snapshot. When given, the pixel is read from that frozen frame instead of the live screen." },
+        { "waitForColor", "Poll the pixel color at a specific coordinate until it matches the expected color, then return a full screenshot. While nothing else needs the whole screen, only the watched pixel is requested from the server, so bandwidth during the wait does not grow with screen size. The poll interval adapts to the measured link: 100 ms on local links, 250 ms on LANs and 1 s on slow links. Returns a timeout error message if the color does not match within the specified duration. When similarity < 1.0, uses HSV color space comparison for fuzzy matching." },
         { "waitForColor/x", "X coordinate of the pixel to monitor in pixels" },
         { "waitForColor/y", "Y coordinate of the pixel to monitor in pixels" },
         { "waitForColor/color", "Expected color in hex format (e.g., \"#FF0000\" for red, \"#FFFFFF\" for white)." },
         { "waitForColor/timeout", "Maximum time to wait in milliseconds (default: 30000, i.e., 30 seconds). Returns a timeout error if the color does not match within this duration." },
         { "waitForColor/similarity", "Similarity threshold from 0.0 to 1.0 (default: 1.0 = exact RGB match). When < 1.0, colors are compared in HSV space. For example, 0.9 means 90% similar is considered a match." },
+        { "watchRegion", "Register a server-side watch on a screen region instead of polling with screenshot or checkPixelColor. When the condition is met, an MCP logging notification (level notice, logger mcp-vnc) is sent with JSON data: the watch handle, condition, region and, for change watches, the changed rectangle. While only watches need updates, the server is asked for the watched regions alone. Returns JSON with the watch handle. Only the client that registered a watch is notified, and its watches end when it goes away or the VNC connection closes." },
+        { "watchRegion/x", "X coordinate of the region's top-left corner in pixels" },
+        { "watchRegion/y", "Y coordinate of the region's top-left corner in pixels" },
+        { "watchRegion/width", "Width of the region in pixels (default: -1 = to the right edge; 1 for color; the template's width for image, which must match it)" },
+        { "watchRegion/height", "Height of the region in pixels (default: -1 = to the bottom edge; 1 for color; the template's height for image, which must match it)" },
+        { "watchRegion/condition", "\"change\" (default): any pixel in the region changes. \"color\": every pixel in the region becomes the given color (by default the region is the single pixel at (x, y)). \"image\": the region becomes the template image, which must be the size of the region. color and image fire when the condition becomes true, including when it already is." },
+        { "watchRegion/color", "Expected color in hex format for the color condition (e.g., \"#FF0000\")" },
+        { "watchRegion/templatePath", "Absolute path of the template image for the image condition" },
+        { "watchRegion/similarity", "Match threshold from 0.0 to 1.0 for color and image (default: 1.0 = exact). Colors compare in HSV space; images by mean channel difference." },
+        { "watchRegion/once", "Remove the watch after it fires once (default: true); false keeps notifying on every change or every time the condition becomes true again" },
+        { "unwatchRegion", "Remove a region watch. Returns false if the handle is unknown, belongs to another client or the watch already fired and was removed." },
+        { "unwatchRegion/watch", "Watch handle returned by watchRegion (e.g., \"watch-1\")" },
         { "setClipboard", "Send text to the VNC server's clipboard via the ClientCutText protocol message. The text will be available for pasting on the remote system." },
         { "setClipboard/text", "The text to send to the remote clipboard" },
         { "getClipboard", "Request and wait for the VNC server's clipboard text via the ServerCutText protocol message. Returns the clipboard text if received within the timeout, or an error message on timeout. Note: the server must actively send its clipboard content (e.g., when the user copies text on the remote system)." },
         { "getClipboard/timeout", "Maximum time to wait for clipboard data in milliseconds (default: 5000, i.e., 5 seconds)" },
+        { "getClipboard/filePath", "Write the text to this file (UTF-8) and return only the path and size instead of the text (optional). Needed for text above the inline limit set with setClipboardLimits." },
         { "setClipboardImage", "Send an image file to the VNC server's clipboard via the Extended Clipboard protocol (DIB format). The image will be available for pasting on the remote system. Requires Extended Clipboard support on the server." },
         { "setClipboardImage/filePath", "Absolute file path of the image to send (e.g., /tmp/image.png). Supports PNG, JPG, BMP, and other Qt-supported image formats." },
         { "getClipboardImage", "Wait for the VNC server to send a clipboard image via the Extended Clipboard protocol (DIB format). Returns the image as base64-encoded data if received within the timeout, or an error message on timeout." },
         { "getClipboardImage/timeout", "Maximum time to wait for clipboard image in milliseconds (default: 5000, i.e., 5 seconds)" },
+        { "getClipboardImage/filePath", "Save the image to this file (format from the suffix, e.g. .png) and return only the path, size and dimensions instead of base64 data (optional). Needed for images above the inline limit set with setClipboardLimits." },
+        { "setClipboardLimits", "Bound the memory and context used by clipboard transfers. Text or images larger than the inline limit are not returned inline; getClipboard and getClipboardImage return an error asking for filePath instead. Payloads larger than the buffer limit are not kept between tool calls and are only delivered to a call that is already waiting. The Extended Clipboard transfers themselves are always zlib-compressed by the protocol." },
+        { "setClipboardLimits/inlineLimit", "Largest payload returned inline, in bytes (default: 1048576 = 1 MB; uncompressed pixel size for images)" },
+        { "setClipboardLimits/bufferLimit", "Largest payload kept between tool calls, in bytes (default: 67108864 = 64 MB)" },
+        { "actAndCapture", "Perform an input action and return a screenshot once the screen has reacted, in a single call. Waits for the first framebuffer change after the action, then for a quiet period without further changes, and returns the bounding box of everything that changed (or the full screen) together with its coordinates. If nothing changes within the timeout, the full screen is returned with a note; if the screen is still changing at the timeout, what changed so far is returned marked as not settled. Use this instead of an action followed by screenshot." },
+        { "actAndCapture/action", "Input action to perform: mouseMove, mouseClick, doubleClick, mousePress, mouseRelease, longPress, dragAndDrop, sendKey or sendText" },
+        { "actAndCapture/params", "Action parameters as a JSON object string, same format as addMacroStep (e.g., \"{\\\"x\\\":400,\\\"y\\\":300}\")" },
+        { "actAndCapture/timeout", "Deadline in milliseconds from the action, for the first change and the quiet period together (default: 5000)" },
+        { "actAndCapture/settle", "Quiet period in milliseconds without further changes before capturing (default: 300). Increase for animated transitions." },
+        { "actAndCapture/fullScreen", "Return the full screen instead of only the changed bounding box (default: false)" },
+        { "measureResponse", "Measure input-to-pixel latency: perform an input action, then time how long until the framebuffer changes inside the given region. Returns JSON with the first and last damage times (min/median/p95/max in ms) over all trials, the same figures with the measured link RTT subtracted (the application's own share), the RTT used and per-trial samples. A trial that produces no damage within the timeout is reported as not responded." },
+        { "measureResponse/action", "Input action to perform: mouseMove, mouseClick, doubleClick, mousePress, mouseRelease, longPress, dragAndDrop, sendKey or sendText" },
+        { "measureResponse/params", "Action parameters as a JSON object string, same format as addMacroStep (e.g., \"{\\\"x\\\":400,\\\"y\\\":300}\")" },
+        { "measureResponse/x", "X coordinate of the watched region in pixels" },
+        { "measureResponse/y", "Y coordinate of the watched region in pixels" },
+        { "measureResponse/width", "Width of the watched region in pixels (default: -1 = to the right edge)" },
+        { "measureResponse/height", "Height of the watched region in pixels (default: -1 = to the bottom edge)" },
+        { "measureResponse/timeout", "Maximum time to wait for a response per trial in milliseconds (default: 5000)" },
+        { "measureResponse/trials", "Number of times to repeat the action (default: 1, max: 100). Use toggling actions (e.g., a key that opens and closes a menu) for repeated trials." },
+        { "measureResponse/settle", "Quiet period in milliseconds after the last damage before a trial is considered complete, and pause between trials (default: 500)" },
+        { "measureFrameRate", "Measure the frame rate of an animated screen region. Framebuffer updates are received for the given duration and every update that changes the region's pixels counts as a frame; updates that resend identical pixels are ignored. Returns JSON with the frame count, achieved fps, frame-time percentiles (min/median/p95/max in ms) and every stall (gap between frames) at least as long as the threshold. Start it while the animation is running." },
+        { "measureFrameRate/x", "X coordinate of the region in pixels" },
+        { "measureFrameRate/y", "Y coordinate of the region in pixels" },
+        { "measureFrameRate/width", "Width of the region in pixels (default: -1 = to the right edge)" },
+        { "measureFrameRate/height", "Height of the region in pixels (default: -1 = to the bottom edge)" },
+        { "measureFrameRate/duration", "Measurement duration in milliseconds (default: 2000, minimum: 100)" },
+        { "measureFrameRate/stallThreshold", "Gap between frames in milliseconds reported as a stall (default: 50)" },
+        { "compareWithImage", "Compare the screen (or a region, or a snapshot) against a golden image file for visual regression checks, directly on the in-memory frame. Returns JSON with mismatchPercent, differingPixels, comparedPixels, the differing areas (bounding boxes in screen coordinates, largest first) and compareMs. The frame includes the cursor, like save. The image must be the size of the region." },
+        { "compareWithImage/filePath", "Absolute path of the golden image (e.g., one written earlier by save)" },
+        { "compareWithImage/x", "X coordinate of the region to compare (default: 0)" },
+        { "compareWithImage/y", "Y coordinate of the region to compare (default: 0)" },
+        { "compareWithImage/width", "Width of the region (default: -1 = to the right edge)" },
+        { "compareWithImage/height", "Height of the region (default: -1 = to the bottom edge)" },
+        { "compareWithImage/tolerance", "Largest per-channel difference (0-255) still treated as equal (default: 0 = exact)" },
+        { "compareWithImage/ignoreMasks", "Areas to ignore, such as clocks or animations, in screen coordinates: \"x,y,width,height;x,y,width,height\" (optional)" },
+        { "compareWithImage/diffPath", "Write a heat map to this file: the screen in dark gray with differing pixels in red, brighter for larger differences (optional)" },
+        { "compareWithImage/snapshot", "Compare a snapshot handle from snapshot() instead of the live screen (optional)" },
+#ifdef HAVE_TESSERACT
+        { "readText", "Recognize the text on screen (or in a region) with on-device OCR and return it as JSON: \"text\" in reading order plus \"words\" with their bounding boxes and confidence. Much smaller than a screenshot when the goal is reading the screen. Results are cached per horizontal band of the screen; only bands that changed since the last call are recognized again (\"recognizedBands\" in the result)." },
+        { "readText/x", "X coordinate of the region's top-left corner in pixels (default: 0)" },
+        { "readText/y", "Y coordinate of the region's top-left corner in pixels (default: 0)" },
+        { "readText/width", "Width of the region in pixels (default: -1 = to the right edge)" },
+        { "readText/height", "Height of the region in pixels (default: -1 = to the bottom edge)" },
+        { "readText/minConfidence", "Drop words recognized with lower confidence, 0-100 (default: 50)" },
+        { "findText", "Find a label on screen with on-device OCR and return where to click it. Returns JSON \"matches\" with the bounding box and center (clickX, clickY) of every occurrence, or an error if the text is not found. Matching ignores case and punctuation; a phrase must appear as consecutive words on one line, a single word may be part of a longer one." },
+        { "findText/text", "Text to find, one word or a phrase (e.g., \"Save\" or \"Open File\")" },
+        { "findText/x", "X coordinate of the region to search (default: 0)" },
+        { "findText/y", "Y coordinate of the region to search (default: 0)" },
+        { "findText/width", "Width of the region to search (default: -1 = to the right edge)" },
+        { "findText/height", "Height of the region to search (default: -1 = to the bottom edge)" },
+        { "findText/minConfidence", "Ignore words recognized with lower confidence, 0-100 (default: 50)" },
+#endif
 #ifdef HAVE_MULTIMEDIA
         { "startRecording", "Start recording the VNC screen to an H.264/MP4 video file. The recording captures frames at the specified FPS rate until stopRecording is called. Requires an active VNC connection with a valid framebuffer. Returns false if already recording, not connected, or no framebuffer is available." },
         { "startRecording/filePath", "Absolute file path for the output MP4 file (e.g., /tmp/recording.mp4). The directory must exist. The file will be overwritten if it already exists." },
@@ -215,7 +368,41 @@ int main(int argc, char *argv[])
         for (auto *session : sessions)
             server.notify(session->sessionId(), notification);
     });
-    QObject::connect(&server, &QMcpServer::newSession, [](QMcpServerSession *session) {
+    QObject::connect(tools, &Tools::statsReported, &server, [&server](const QUuid &session, const QJsonObject &stats) {
+        QMcpLoggingMessageNotification notification;
+        auto params = notification.params();
+        params.setLevel(QMcpLoggingLevel::info);
+        params.setLogger("mcp-vnc"_L1);
+        params.setData(QJsonValue(stats));
+        notification.setParams(params);
+        if (!session.isNull()) {
+            server.notify(session, notification);
+            return;
+        }
+        const auto sessions = server.sessions();
+        for (auto *session : sessions)
+            server.notify(session->sessionId(), notification);
+    });
+    QObject::connect(tools, &Tools::regionWatchTriggered, &server, [&server](const QUuid &session, const QJsonObject &event) {
+        QMcpLoggingMessageNotification notification;
+        auto params = notification.params();
+        params.setLevel(QMcpLoggingLevel::notice);
+        params.setLogger("mcp-vnc"_L1);
+        params.setData(QJsonValue(event));
+        notification.setParams(params);
+        if (!session.isNull()) {
+            server.notify(session, notification);
+            return;
+        }
+        const auto sessions = server.sessions();
+        for (auto *session : sessions)
+            server.notify(session->sessionId(), notification);
+    });
+    QObject::connect(&server, &QMcpServer::newSession, [tools](QMcpServerSession *session) {
+        QObject::connect(session, &QObject::destroyed, tools, [tools, id = session->sessionId()]() {
+            tools->detachSession(id);
+        });
+
         // setup-qt prompt
         {
             QMcpPrompt prompt;
@@ -399,12 +586,7 @@ int main(int argc, char *argv[])
     });
 
     QObject::connect(&server, &QMcpServer::finished, &app, &QCoreApplication::quit);
-    server.start();
-
-    VncWidget vncWidget;
-    vncWidget.setClient(tools->client());
-    vncWidget.setWindowTitle(app.applicationName());
-    tools->setPreviewWidget(&vncWidget);
+    server.start(parser.value(listenOption));
 
     return app.exec();
 }
@@ -0,0 +1,201 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "screenshotstore.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <QtGui/QImageWriter>
+#ifdef Q_OS_UNIX
+#include <cstdio>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <qt_windows.h>
+#endif
+
+// Renames from over to, replacing an existing file in one step
+static bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_UNIX
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(to).utf16()), MOVEFILE_REPLACE_EXISTING);
+#else
+    return QFile::remove(to) && QFile::rename(from, to);
+#endif
+}
+
+// jpg and jpeg name the same encoder
+static QByteArray canonicalFormat(const QByteArray &format)
+{
+    return format == "jpeg" ? QByteArray("jpg") : format;
+}
+
+static bool hardLink(const QString &target, const QString &link)
+{
+#ifdef Q_OS_UNIX
+    return ::link(QFile::encodeName(target).constData(), QFile::encodeName(link).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    return CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(link).utf16()),
+                           reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(target).utf16()), nullptr);
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(link);
+    return false;
+#endif
+}
+
+ScreenshotStore::ScreenshotStore()
+{
+    // One thread keeps saves ordered and the object set single-threaded
+    m_pool.setMaxThreadCount(1);
+}
+
+ScreenshotStore::~ScreenshotStore()
+{
+    m_pool.waitForDone();
+}
+
+bool ScreenshotStore::open(const QString &directory, const QByteArray &format, bool hardLinks)
+{
+    close();
+    const QByteArray lowerFormat = format.toLower();
+    if (!QImageWriter::supportedImageFormats().contains(lowerFormat)) {
+        m_error = QStringLiteral("unsupported image format '%1'").arg(QString::fromLatin1(format));
+        return false;
+    }
+    const QDir dir(directory);
+    if (!dir.mkpath(QStringLiteral("objects"))) {
+        m_error = QStringLiteral("cannot create %1").arg(dir.filePath(QStringLiteral("objects")));
+        return false;
+    }
+    m_directory = dir.absolutePath();
+    m_format = lowerFormat;
+    m_hardLinks = hardLinks;
+    m_error.clear();
+    return true;
+}
+
+void ScreenshotStore::close()
+{
+    m_pool.waitForDone();
+    m_directory.clear();
+    m_objects.clear();
+}
+
+QFuture<ScreenshotStore::Result> ScreenshotStore::save(const QImage &image, const QRect &region, const QString &path)
+{
+    Q_ASSERT(isOpen());
+    const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    return QtConcurrent::run(&m_pool, [this, image, region, path, timestamp]() {
+        return write(image, region, path, timestamp);
+    });
+}
+
+// Covers geometry and pixel format too, so equal bytes in a different shape
+// never collide; row padding is left out
+QString ScreenshotStore::contentHash(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Blake2b_256);
+    const qint32 header[3] = { image.width(), image.height(), qint32(image.format()) };
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(header), sizeof(header)));
+    const qsizetype rowBytes = (qsizetype(image.width()) * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+        hash.addData(QByteArrayView(reinterpret_cast<const char *>(image.constScanLine(y)), rowBytes));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+ScreenshotStore::Result ScreenshotStore::write(const QImage &image, const QRect &region, const QString &path, qint64 timestamp)
+{
+    Result result;
+    if (image.isNull()) {
+        result.error = QStringLiteral("no framebuffer available");
+        return result;
+    }
+
+    result.hash = contentHash(image);
+    const QDir objects(m_directory + QStringLiteral("/objects/") + result.hash.left(2));
+    result.objectPath = objects.filePath(result.hash + QLatin1Char('.') + QString::fromLatin1(m_format));
+    result.duplicate = m_objects.contains(result.hash) || QFileInfo::exists(result.objectPath);
+    if (!result.duplicate) {
+        // Written under a temporary name, so an interrupted encode never
+        // leaves a truncated object that later saves would link to
+        QSaveFile file(result.objectPath);
+        if (!objects.mkpath(QStringLiteral(".")) || !file.open(QIODevice::WriteOnly)
+            || !image.save(&file, m_format.constData()) || !file.commit()) {
+            result.error = QStringLiteral("cannot write %1").arg(result.objectPath);
+            return result;
+        }
+    }
+    m_objects.insert(result.hash);
+
+    if (!path.isEmpty()) {
+        const QString target = QFileInfo(path).absoluteFilePath();
+        if (target != result.objectPath && !writeCopy(image, result.objectPath, target, &result.error))
+            return result;
+        result.path = path;
+    }
+
+    QJsonObject entry;
+    entry[QStringLiteral("t")] = timestamp;
+    entry[QStringLiteral("hash")] = result.hash;
+    entry[QStringLiteral("x")] = region.x();
+    entry[QStringLiteral("y")] = region.y();
+    entry[QStringLiteral("w")] = region.width();
+    entry[QStringLiteral("h")] = region.height();
+    if (!path.isEmpty())
+        entry[QStringLiteral("path")] = path;
+    QFile index(m_directory + QStringLiteral("/index.jsonl"));
+    if (!index.open(QIODevice::WriteOnly | QIODevice::Append)
+        || index.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n') < 0)
+        result.error = QStringLiteral("cannot append to %1").arg(index.fileName());
+    return result;
+}
+
+// As with a plain save, the suffix picks the format: the object is reused
+// when it matches and the frame is encoded again otherwise. The file only
+// replaces an existing one once it is complete.
+bool ScreenshotStore::writeCopy(const QImage &image, const QString &objectPath, const QString &target, QString *error) const
+{
+    QByteArray format = QFileInfo(target).suffix().toLower().toLatin1();
+    if (format.isEmpty() || canonicalFormat(format) == canonicalFormat(m_format)) {
+        format.clear();
+    } else if (!QImageWriter::supportedImageFormats().contains(format)) {
+        *error = QStringLiteral("unsupported image format '%1'").arg(QString::fromLatin1(format));
+        return false;
+    }
+
+    if (format.isEmpty() && m_hardLinks) {
+        // A link shares the object's permissions, so nobody writes through
+        // it into every other save of this frame
+        const QFile::Permissions readOnly = QFile::ReadOwner | QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther;
+        const QString link = target + QStringLiteral(".link");
+        QFile::remove(link);
+        if (QFile::setPermissions(objectPath, readOnly) && hardLink(objectPath, link)) {
+            if (replaceFile(link, target))
+                return true;
+            QFile::remove(link);
+        }
+    }
+
+    QSaveFile file(target);
+    bool written = file.open(QIODevice::WriteOnly);
+    if (written && format.isEmpty()) {
+        QFile object(objectPath);
+        written = object.open(QIODevice::ReadOnly) && file.write(object.readAll()) == object.size();
+    } else if (written) {
+        written = image.save(&file, format.constData());
+    }
+    if (!written || !file.commit()) {
+        *error = QStringLiteral("cannot write %1").arg(target);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SCREENSHOTSTORE_H
+#define SCREENSHOTSTORE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFuture>
+#include <QtCore/QRect>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+
+// Content-addressed archive for saved screenshots. Every distinct image is
+// encoded once, to objects/<first two hex digits>/<hash>.<format> below the
+// store directory; saving identical pixels again encodes nothing and copies
+// the existing object to the requested path, or encodes the frame again
+// when the path's suffix names another format. With hard links enabled the
+// path is linked to the object instead (falling back to a copy where links
+// are unsupported) and objects are made read-only first, since editing a
+// linked path would otherwise change every save of the same frame. The
+// path is only replaced once the new file is complete. Each save appends
+// one line to index.jsonl, with "path" only when a copy was requested:
+//   {"h":1080,"hash":"...","path":"...","t":<ms since epoch>,"w":1920,"x":0,"y":0}
+// Hashing, encoding and file I/O run on one dedicated thread, so saves are
+// applied in order and the event loop never waits on the disk.
+class ScreenshotStore
+{
+public:
+    struct Result
+    {
+        QString hash;
+        QString objectPath;
+        QString path; // the copy or link, empty if none was requested
+        bool duplicate = false;
+        QString error;
+    };
+
+    ScreenshotStore();
+    ~ScreenshotStore();
+
+    // Waits for pending saves of a previously opened store first
+    bool open(const QString &directory, const QByteArray &format, bool hardLinks = false);
+    void close();
+
+    bool isOpen() const { return !m_directory.isEmpty(); }
+    QString directory() const { return m_directory; }
+    QByteArray format() const { return m_format; }
+    bool hardLinks() const { return m_hardLinks; }
+    QString errorString() const { return m_error; }
+
+    // region is where image came from, in framebuffer coordinates
+    QFuture<Result> save(const QImage &image, const QRect &region, const QString &path);
+
+private:
+    static QString contentHash(const QImage &image);
+    Result write(const QImage &image, const QRect &region, const QString &path, qint64 timestamp);
+    bool writeCopy(const QImage &image, const QString &objectPath, const QString &target, QString *error) const;
+
+    QThreadPool m_pool;
+    QString m_directory;
+    QByteArray m_format;
+    bool m_hardLinks = false;
+    QString m_error;
+    // Objects known to exist; only touched on the pool's thread
+    QSet<QString> m_objects;
+};
+
+#endif // SCREENSHOTSTORE_H
@@ -0,0 +1,161 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "sharedframebuffer.h"
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+
+static_assert(sizeof(SharedFramebuffer::Header) <= SharedFramebuffer::PixelOffset);
+static_assert(std::atomic<quint64>::is_always_lock_free, "the sequence must be usable across processes");
+
+SharedFramebuffer::~SharedFramebuffer()
+{
+    stop();
+}
+
+SharedFramebuffer::Header *SharedFramebuffer::header() const
+{
+    return static_cast<Header *>(m_memory->data());
+}
+
+bool SharedFramebuffer::allocate(const QImage &image)
+{
+    stop();
+
+    // POSIX names are global, so readers open them from any directory. Qt's
+    // default on Linux is System V, whose key is an ftok file; that one goes
+    // to the temporary directory rather than the working directory.
+    QString name = QStringLiteral("mcp-vnc-%1-%2").arg(QCoreApplication::applicationPid()).arg(++m_serial);
+    QNativeIpcKey::Type type = QNativeIpcKey::DefaultTypeForOs;
+    if (QSharedMemory::isKeyTypeSupported(QNativeIpcKey::Type::PosixRealtime))
+        type = QNativeIpcKey::Type::PosixRealtime;
+    if (type == QNativeIpcKey::Type::PosixRealtime)
+        name.prepend(QLatin1Char('/'));
+    else if (type != QNativeIpcKey::Type::Windows)
+        name = QDir::temp().absoluteFilePath(name);
+
+    auto memory = std::make_unique<QSharedMemory>(QNativeIpcKey(name, type));
+    if (!memory->create(PixelOffset + image.sizeInBytes())) {
+        m_error = memory->errorString();
+        return false;
+    }
+    m_memory = std::move(memory);
+
+    Header *h = new (m_memory->data()) Header {};
+    h->magic = Magic;
+    h->version = Version;
+    h->width = quint32(image.width());
+    h->height = quint32(image.height());
+    h->stride = quint32(image.bytesPerLine());
+    h->format = quint32(image.format());
+    m_error.clear();
+    return true;
+}
+
+void SharedFramebuffer::stop()
+{
+    if (!m_memory)
+        return;
+    header()->magic = 0;
+    m_memory->detach();
+    m_memory.reset();
+}
+
+bool SharedFramebuffer::publish(const QImage &image, const QList<QRect> &damage)
+{
+    if (image.isNull())
+        return false;
+
+    QList<QRect> rects = damage;
+    Header *h = m_memory ? header() : nullptr;
+    if (!h || h->width != quint32(image.width()) || h->height != quint32(image.height())
+        || h->stride != quint32(image.bytesPerLine()) || h->format != quint32(image.format())) {
+        if (!allocate(image))
+            return false;
+        h = header();
+        rects.clear();
+    }
+
+    if (rects.isEmpty())
+        rects.append(image.rect());
+    if (rects.size() > MaxDamageRects) {
+        QRect bounds;
+        for (const QRect &rect : std::as_const(rects))
+            bounds |= rect;
+        rects = { bounds };
+    }
+
+    const quint64 sequence = h->sequence.load(std::memory_order_relaxed);
+    h->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto *pixels = static_cast<uchar *>(m_memory->data()) + PixelOffset;
+    const qsizetype stride = image.bytesPerLine();
+    const int bytesPerPixel = image.depth() / 8;
+    quint32 count = 0;
+    for (const QRect &rect : std::as_const(rects)) {
+        const QRect r = rect.intersected(image.rect());
+        if (r.isEmpty())
+            continue;
+        const qsizetype offset = qsizetype(r.x()) * bytesPerPixel;
+        const qsizetype length = qsizetype(r.width()) * bytesPerPixel;
+        for (int y = r.top(); y <= r.bottom(); ++y)
+            std::memcpy(pixels + y * stride + offset, image.constScanLine(y) + offset, length);
+        h->damage[count][0] = r.x();
+        h->damage[count][1] = r.y();
+        h->damage[count][2] = r.width();
+        h->damage[count][3] = r.height();
+        ++count;
+    }
+    h->damageCount = count;
+    ++h->frame;
+
+    h->sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+QJsonObject SharedFramebuffer::layout() const
+{
+    QJsonObject obj;
+    if (!m_memory)
+        return obj;
+    const Header *h = header();
+    QString keyType;
+    switch (m_memory->nativeIpcKey().type()) {
+    case QNativeIpcKey::Type::PosixRealtime:
+        keyType = QStringLiteral("posix");
+        break;
+    case QNativeIpcKey::Type::SystemV:
+        keyType = QStringLiteral("systemv");
+        break;
+    case QNativeIpcKey::Type::Windows:
+        keyType = QStringLiteral("windows");
+        break;
+    }
+    obj[QStringLiteral("name")] = m_memory->nativeIpcKey().nativeKey();
+    obj[QStringLiteral("keyType")] = keyType;
+    obj[QStringLiteral("size")] = qint64(m_memory->size());
+    obj[QStringLiteral("width")] = qint64(h->width);
+    obj[QStringLiteral("height")] = qint64(h->height);
+    obj[QStringLiteral("stride")] = qint64(h->stride);
+    obj[QStringLiteral("format")] = qint64(h->format);
+    obj[QStringLiteral("pixelOffset")] = PixelOffset;
+
+    QJsonObject offsets;
+    offsets[QStringLiteral("magic")] = qint64(offsetof(Header, magic));
+    offsets[QStringLiteral("version")] = qint64(offsetof(Header, version));
+    offsets[QStringLiteral("sequence")] = qint64(offsetof(Header, sequence));
+    offsets[QStringLiteral("frame")] = qint64(offsetof(Header, frame));
+    offsets[QStringLiteral("width")] = qint64(offsetof(Header, width));
+    offsets[QStringLiteral("height")] = qint64(offsetof(Header, height));
+    offsets[QStringLiteral("stride")] = qint64(offsetof(Header, stride));
+    offsets[QStringLiteral("format")] = qint64(offsetof(Header, format));
+    offsets[QStringLiteral("damageCount")] = qint64(offsetof(Header, damageCount));
+    offsets[QStringLiteral("damage")] = qint64(offsetof(Header, damage));
+    obj[QStringLiteral("headerOffsets")] = offsets;
+    obj[QStringLiteral("maxDamageRects")] = MaxDamageRects;
+    return obj;
+}
@@ -0,0 +1,66 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SHAREDFRAMEBUFFER_H
+#define SHAREDFRAMEBUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QRect>
+#include <QtCore/QSharedMemory>
+#include <QtGui/QImage>
+
+// Publishes the framebuffer into a shared memory segment for co-located
+// readers. The segment starts with a Header; pixels follow at PixelOffset,
+// `stride` bytes per row. Writers bump `sequence` to an odd value before
+// touching the segment and to the next even value afterwards, so a reader
+// copies what it needs between two equal, even loads of `sequence` (acquire
+// on the first, acquire fence before the second) and retries otherwise.
+// `damage` lists the rectangles changed by the latest frame. A segment whose
+// magic reads 0 has been retired, e.g. on a resize; query the new name.
+class SharedFramebuffer
+{
+public:
+    static constexpr quint32 Magic = 0x4246564d; // "MVFB" little-endian
+    static constexpr quint32 Version = 1;
+    static constexpr int MaxDamageRects = 64;
+    static constexpr qsizetype PixelOffset = 4096;
+
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        std::atomic<quint64> sequence;
+        quint64 frame;
+        quint32 width;
+        quint32 height;
+        quint32 stride;
+        quint32 format; // QImage::Format
+        quint32 damageCount;
+        quint32 reserved;
+        qint32 damage[MaxDamageRects][4]; // x, y, width, height
+    };
+
+    ~SharedFramebuffer();
+
+    // Copies the damaged parts of image into the segment, (re)creating it
+    // when the geometry no longer fits. An empty damage list copies it all.
+    bool publish(const QImage &image, const QList<QRect> &damage);
+    void stop();
+
+    bool isActive() const { return m_memory != nullptr; }
+    QString errorString() const { return m_error; }
+    QJsonObject layout() const;
+
+private:
+    bool allocate(const QImage &image);
+    Header *header() const;
+
+    std::unique_ptr<QSharedMemory> m_memory;
+    QString m_error;
+    int m_serial = 0;
+};
+
+#endif // SHAREDFRAMEBUFFER_H
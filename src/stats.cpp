@@ -0,0 +1,132 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "stats.h"
+#include <bit>
+#include <cmath>
+
+int LatencyHistogram::bucketFor(quint64 usecs)
+{
+    if (usecs < LinearBuckets)
+        return int(usecs);
+    const int exponent = std::bit_width(usecs) - 1;
+    const int sub = int(usecs >> (exponent - 2)) & (SubBuckets - 1);
+    return qMin(LinearBuckets + (exponent - 4) * SubBuckets + sub, BucketCount - 1);
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket < LinearBuckets)
+        return quint64(bucket) + 1;
+    const int exponent = (bucket - LinearBuckets) / SubBuckets + 4;
+    const int sub = (bucket - LinearBuckets) % SubBuckets;
+    return quint64(SubBuckets + sub + 1) << (exponent - 2);
+}
+
+void LatencyHistogram::record(qint64 nsecs)
+{
+    nsecs = qMax<qint64>(0, nsecs);
+    m_buckets[bucketFor(quint64(nsecs) / 1000)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumNsecs.fetch_add(quint64(nsecs), std::memory_order_relaxed);
+    qint64 max = m_maxNsecs.load(std::memory_order_relaxed);
+    while (nsecs > max && !m_maxNsecs.compare_exchange_weak(max, nsecs, std::memory_order_relaxed)) {
+    }
+}
+
+qint64 LatencyHistogram::quantileNsecs(double q) const
+{
+    const quint64 total = count();
+    if (total == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(q * double(total))));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return qMin<qint64>(qint64(bucketUpperBound(i)) * 1000, m_maxNsecs.load(std::memory_order_relaxed));
+    }
+    return m_maxNsecs.load(std::memory_order_relaxed);
+}
+
+QJsonObject LatencyHistogram::toJson() const
+{
+    const quint64 total = count();
+    QJsonObject obj;
+    obj[QStringLiteral("count")] = qint64(total);
+    if (total == 0)
+        return obj;
+    const auto ms = [](qint64 nsecs) { return double(nsecs) / 1e6; };
+    obj[QStringLiteral("meanMs")] = ms(qint64(m_sumNsecs.load(std::memory_order_relaxed) / total));
+    obj[QStringLiteral("p50Ms")] = ms(quantileNsecs(0.50));
+    obj[QStringLiteral("p95Ms")] = ms(quantileNsecs(0.95));
+    obj[QStringLiteral("p99Ms")] = ms(quantileNsecs(0.99));
+    obj[QStringLiteral("maxMs")] = ms(m_maxNsecs.load(std::memory_order_relaxed));
+    return obj;
+}
+
+Stats::Stats(const QList<QByteArray> &toolNames)
+{
+    for (const QByteArray &name : toolNames) {
+        if (!m_tools.contains(name))
+            m_tools.insert(name, new ToolStats);
+    }
+    m_uptime.start();
+    m_windowStart.store(m_uptime.elapsed(), std::memory_order_relaxed);
+}
+
+Stats::~Stats()
+{
+    qDeleteAll(m_tools);
+}
+
+Stats::Call Stats::call(const char *tool) const
+{
+    if (m_internalDepth > 0)
+        return Call(nullptr, tool);
+    return Call(m_tools.value(QByteArray::fromRawData(tool, qstrlen(tool))), tool);
+}
+
+void Stats::addFramebufferUpdate()
+{
+    m_framebufferUpdates.fetch_add(1, std::memory_order_relaxed);
+    const qint64 now = m_uptime.elapsed();
+    const qint64 start = m_windowStart.load(std::memory_order_relaxed);
+    const quint64 inWindow = m_windowCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (now - start >= 1000) {
+        m_updatesPerSecond.store(inWindow * 1000 / quint64(now - start), std::memory_order_relaxed);
+        m_windowStart.store(now, std::memory_order_relaxed);
+        m_windowCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+QJsonObject Stats::toJson() const
+{
+    QJsonObject tools;
+    for (auto it = m_tools.cbegin(); it != m_tools.cend(); ++it) {
+        if (it.value()->latency.count() > 0)
+            tools[QString::fromLatin1(it.key())] = it.value()->latency.toJson();
+    }
+
+    // The rate window only closes on the next update; report 0 once idle
+    const qint64 idle = m_uptime.elapsed() - m_windowStart.load(std::memory_order_relaxed);
+    const quint64 rate = idle > 2000 ? 0 : m_updatesPerSecond.load(std::memory_order_relaxed);
+
+    QJsonObject transfer;
+    transfer[QStringLiteral("bytesReceived")] = qint64(m_bytesReceived.load(std::memory_order_relaxed));
+    transfer[QStringLiteral("bytesSent")] = qint64(m_bytesSent.load(std::memory_order_relaxed));
+    transfer[QStringLiteral("framebufferUpdates")] = qint64(m_framebufferUpdates.load(std::memory_order_relaxed));
+    transfer[QStringLiteral("framebufferUpdatesPerSecond")] = qint64(rate);
+
+    QJsonObject timings;
+    timings[QStringLiteral("decode")] = decodeTime.toJson();
+    timings[QStringLiteral("composite")] = compositeTime.toJson();
+    timings[QStringLiteral("encode")] = encodeTime.toJson();
+
+    QJsonObject obj;
+    obj[QStringLiteral("uptimeMs")] = m_uptime.elapsed();
+    obj[QStringLiteral("tools")] = tools;
+    obj[QStringLiteral("transfer")] = transfer;
+    obj[QStringLiteral("timings")] = timings;
+    return obj;
+}
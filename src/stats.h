@@ -0,0 +1,154 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <utility>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include "trace.h"
+
+// Lock-free latency histogram. Values are bucketed in microseconds with four
+// linear sub-buckets per power of two, so quantiles are accurate to ~25%.
+class LatencyHistogram
+{
+public:
+    void record(qint64 nsecs);
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    qint64 quantileNsecs(double q) const;
+    QJsonObject toJson() const;
+
+private:
+    static constexpr int LinearBuckets = 16;
+    static constexpr int SubBuckets = 4;
+    static constexpr int BucketCount = LinearBuckets + 40 * SubBuckets;
+
+    static int bucketFor(quint64 usecs);
+    static quint64 bucketUpperBound(int bucket);
+
+    std::array<std::atomic<quint64>, BucketCount> m_buckets {};
+    std::atomic<quint64> m_count { 0 };
+    std::atomic<quint64> m_sumNsecs { 0 };
+    std::atomic<qint64> m_maxNsecs { 0 };
+};
+
+// Process-wide counters for getStats. Everything touched on the hot path is a
+// relaxed atomic; the per-tool table is built once and only read afterwards.
+class Stats
+{
+public:
+    struct ToolStats
+    {
+        LatencyHistogram latency;
+    };
+
+    // Times one tool invocation. Records on destruction unless the result is
+    // handed to track(), in which case it records when the future finishes.
+    class Call
+    {
+    public:
+        Call(ToolStats *tool, const char *name)
+            : m_tool(tool)
+            , m_name(name)
+        {
+            if (m_tool)
+                m_timer.start();
+        }
+        Call(const Call &) = delete;
+        Call &operator=(const Call &) = delete;
+        ~Call()
+        {
+            if (m_tool)
+                finish(m_tool, m_name, m_timer, false);
+        }
+
+        template <typename T>
+        QFuture<T> track(const QFuture<T> &future)
+        {
+            ToolStats *tool = std::exchange(m_tool, nullptr);
+            if (!tool)
+                return future;
+            const char *name = m_name;
+            const QElapsedTimer timer = m_timer;
+            auto *watcher = new QFutureWatcher<T>;
+            QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [watcher, tool, name, timer]() {
+                finish(tool, name, timer, true);
+                watcher->deleteLater();
+            });
+            watcher->setFuture(future);
+            return future;
+        }
+
+    private:
+        // Tracked calls overlap each other and the frame spans, so they are
+        // traced as async pairs; synchronous calls nest and stay 'X' events
+        static void finish(ToolStats *tool, const char *name, const QElapsedTimer &timer, bool tracked)
+        {
+            const qint64 elapsed = timer.nsecsElapsed();
+            tool->latency.record(elapsed);
+            if (tracked)
+                Tracer::instance()->async(name, "tool", elapsed);
+            else
+                Tracer::instance()->complete(name, "tool", elapsed);
+        }
+
+        ToolStats *m_tool;
+        const char *m_name;
+        QElapsedTimer m_timer;
+    };
+
+    // Marks tool calls the server makes on its own behalf, such as macro
+    // steps or the status report that ends connect. They are not client
+    // requests, so call() neither counts nor traces them while one is alive.
+    class Internal
+    {
+    public:
+        explicit Internal(Stats &stats)
+            : m_stats(stats)
+        {
+            ++m_stats.m_internalDepth;
+        }
+        Internal(const Internal &) = delete;
+        Internal &operator=(const Internal &) = delete;
+        ~Internal() { --m_stats.m_internalDepth; }
+
+    private:
+        Stats &m_stats;
+    };
+
+    explicit Stats(const QList<QByteArray> &toolNames);
+    ~Stats();
+
+    // Main thread only, like the tools themselves
+    Call call(const char *tool) const;
+
+    void addBytesReceived(qint64 bytes) { m_bytesReceived.fetch_add(bytes, std::memory_order_relaxed); }
+    void addBytesSent(qint64 bytes) { m_bytesSent.fetch_add(bytes, std::memory_order_relaxed); }
+    void addFramebufferUpdate();
+
+    LatencyHistogram decodeTime;
+    LatencyHistogram compositeTime;
+    LatencyHistogram encodeTime;
+
+    QJsonObject toJson() const;
+
+private:
+    QHash<QByteArray, ToolStats *> m_tools;
+    int m_internalDepth = 0;
+    QElapsedTimer m_uptime;
+    std::atomic<quint64> m_bytesReceived { 0 };
+    std::atomic<quint64> m_bytesSent { 0 };
+    std::atomic<quint64> m_framebufferUpdates { 0 };
+    // One-second rate window for framebuffer updates
+    std::atomic<qint64> m_windowStart { 0 };
+    std::atomic<quint64> m_windowCount { 0 };
+    std::atomic<quint64> m_updatesPerSecond { 0 };
+};
+
+#endif // STATS_H
@@ -0,0 +1,152 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include "loopbackserver.h"
+#include "tools.h"
+
+using namespace Qt::Literals::StringLiterals;
+
+// Canceling a tool call mid-wait must give back everything the call took:
+// update holds, regions of interest and its place in a pending refresh.
+class tst_Cancellation : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void screenshot();
+    void checkPixelColor();
+    void waitForColor();
+    void measureResponse();
+    void actAndCapture();
+    void measureFrameRate();
+    void dragAndDrop();
+
+private:
+    QJsonObject updates() const;
+    // Updates off and nothing waiting: the next reader has to refresh
+    void waitUntilIdle();
+    void cancel(QFuture<QList<QMcpCallToolResultContent>> future);
+
+    LoopbackServer m_server { QSize(320, 240) };
+    Tools m_tools;
+};
+
+QJsonObject tst_Cancellation::updates() const
+{
+    return QJsonDocument::fromJson(m_tools.getStats().toUtf8()).object().value("updates"_L1).toObject();
+}
+
+void tst_Cancellation::waitUntilIdle()
+{
+    QTRY_VERIFY_WITH_TIMEOUT(!updates().value("enabled"_L1).toBool(), 5000);
+    QCOMPARE(updates().value("holds"_L1).toInt(), 0);
+    QCOMPARE(updates().value("regionsOfInterest"_L1).toInt(), 0);
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 0);
+}
+
+void tst_Cancellation::cancel(QFuture<QList<QMcpCallToolResultContent>> future)
+{
+    QVERIFY(!future.isFinished());
+    future.cancel();
+    QTRY_VERIFY(future.isFinished());
+    QTRY_COMPARE(updates().value("holds"_L1).toInt(), 0);
+    QCOMPARE(updates().value("regionsOfInterest"_L1).toInt(), 0);
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 0);
+    QTRY_VERIFY_WITH_TIMEOUT(!updates().value("enabled"_L1).toBool(), 5000);
+}
+
+void tst_Cancellation::initTestCase()
+{
+    QVERIFY(m_server.listen());
+    auto future = m_tools.connect("127.0.0.1"_L1, m_server.port(), {}, {}, 10000);
+    QTRY_VERIFY_WITH_TIMEOUT(future.isFinished(), 10000);
+    QVERIFY(m_tools.status().startsWith("connected"_L1));
+}
+
+void tst_Cancellation::init()
+{
+    waitUntilIdle();
+}
+
+void tst_Cancellation::screenshot()
+{
+    auto future = m_tools.screenshot();
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 1);
+    cancel(future);
+}
+
+void tst_Cancellation::checkPixelColor()
+{
+    // Two readers share one refresh; the one left behind still gets its frame
+    auto canceled = m_tools.checkPixelColor(0, 0, "#000000"_L1);
+    auto kept = m_tools.screenshot();
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 2);
+    canceled.cancel();
+    QTRY_VERIFY(canceled.isFinished());
+    QTRY_VERIFY_WITH_TIMEOUT(kept.isFinished(), 5000);
+    QVERIFY(!kept.isCanceled());
+    QVERIFY(!kept.result().isEmpty());
+    QCOMPARE(updates().value("holds"_L1).toInt(), 0);
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 0);
+}
+
+void tst_Cancellation::waitForColor()
+{
+    auto future = m_tools.waitForColor(10, 10, "#123456"_L1, 60000);
+    QCOMPARE(updates().value("regionsOfInterest"_L1).toInt(), 1);
+    QTest::qWait(100);
+    cancel(future);
+}
+
+void tst_Cancellation::measureResponse()
+{
+    // The loopback server does not react to the pointer, so every trial
+    // would run into its timeout
+    auto future = m_tools.measureResponse("mouseMove"_L1, R"({"x":5,"y":5})"_L1, 0, 0, -1, -1, 60000, 10);
+    QVERIFY(updates().value("holds"_L1).toInt() > 0);
+    QTest::qWait(100);
+    cancel(future);
+}
+
+void tst_Cancellation::actAndCapture()
+{
+    auto future = m_tools.actAndCapture("mouseMove"_L1, R"({"x":6,"y":6})"_L1, 60000);
+    QVERIFY(updates().value("holds"_L1).toInt() > 0);
+    QTest::qWait(100);
+    cancel(future);
+}
+
+void tst_Cancellation::measureFrameRate()
+{
+    // Canceled while the priming refresh is still pending
+    auto priming = m_tools.measureFrameRate(0, 0, -1, -1, 60000);
+    QCOMPARE(updates().value("refreshWaiters"_L1).toInt(), 1);
+    cancel(priming);
+
+    // And while measuring
+    auto measuring = m_tools.measureFrameRate(0, 0, -1, -1, 60000);
+    QTRY_COMPARE(updates().value("refreshWaiters"_L1).toInt(), 0);
+    QTest::qWait(100);
+    cancel(measuring);
+}
+
+void tst_Cancellation::dragAndDrop()
+{
+    QSignalSpy pointer(&m_server, &LoopbackServer::pointerEvent);
+    auto future = m_tools.dragAndDrop(50, 50);
+    QTRY_VERIFY(!pointer.isEmpty());
+    QVERIFY(pointer.last().at(2).toInt() != 0);
+    cancel(future);
+    // The button is not left held on the server
+    QTRY_COMPARE(pointer.last().at(2).toInt(), 0);
+}
+
+QTEST_MAIN(tst_Cancellation)
+#include "tst_cancellation.moc"
@@ -0,0 +1,116 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "textrecognizer.h"
+#include <tesseract/baseapi.h>
+#include <tesseract/resultiterator.h>
+
+TextRecognizer::TextRecognizer() = default;
+
+TextRecognizer::~TextRecognizer()
+{
+    if (m_api)
+        m_api->End();
+}
+
+bool TextRecognizer::isReady()
+{
+    if (m_initialized)
+        return m_api != nullptr;
+    m_initialized = true;
+    const QByteArray language = qEnvironmentVariableIsSet("MCP_VNC_OCR_LANG")
+        ? qgetenv("MCP_VNC_OCR_LANG") : QByteArray("eng");
+    auto api = std::make_unique<tesseract::TessBaseAPI>();
+    if (api->Init(nullptr, language.constData(), tesseract::OEM_LSTM_ONLY) != 0) {
+        m_error = QStringLiteral("cannot load Tesseract data for '%1'; install it or set TESSDATA_PREFIX")
+                      .arg(QString::fromLatin1(language));
+        return false;
+    }
+    // Screens scatter short labels rather than paragraphs
+    api->SetPageSegMode(tesseract::PSM_SPARSE_TEXT);
+    m_api = std::move(api);
+    return true;
+}
+
+// RFB limits framebuffers to 16-bit coordinates
+quint64 TextRecognizer::bandKey(const QRect &core)
+{
+    return quint64(quint16(core.x())) << 48 | quint64(quint16(core.y())) << 32
+        | quint64(quint16(core.width())) << 16 | quint64(quint16(core.height()));
+}
+
+void TextRecognizer::clear()
+{
+    m_bands.clear();
+    m_damage = QRegion();
+}
+
+QList<TextRecognizer::Word> TextRecognizer::recognize(const QImage &image, const QRect &region, Stats *stats)
+{
+    QList<Word> words;
+    const QRect area = region & image.rect();
+    if (area.isEmpty() || !isReady())
+        return words;
+
+    const int bytesPerPixel = image.depth() / 8;
+    for (int y = area.top(); y <= area.bottom(); y += BandHeight) {
+        const QRect core(area.left(), y, area.width(), qMin(BandHeight, area.bottom() + 1 - y));
+        const QRect band = core.adjusted(0, -Overlap / 2, 0, Overlap / 2) & area;
+        if (stats)
+            ++stats->bands;
+
+        const quint64 key = bandKey(core);
+        auto it = m_bands.find(key);
+        if (it != m_bands.end() && !m_damage.intersects(band)) {
+            words.append(it->words);
+            continue;
+        }
+        // Damage is often repainted with the same pixels (blinking carets
+        // elsewhere in the rect, redraws of unchanged widgets)
+        size_t hash = 0;
+        for (int row = band.top(); row <= band.bottom(); ++row)
+            hash = qHashBits(image.constScanLine(row) + band.left() * bytesPerPixel, band.width() * bytesPerPixel, hash);
+        if (it == m_bands.end() || it->hash != hash) {
+            if (stats)
+                ++stats->recognized;
+            it = m_bands.insert(key, { hash, recognizeBand(image, band, core) });
+        }
+        words.append(it->words);
+    }
+    // Bands of this region are current again; damage elsewhere stays
+    m_damage -= area;
+    return words;
+}
+
+QList<TextRecognizer::Word> TextRecognizer::recognizeBand(const QImage &image, const QRect &band, const QRect &core)
+{
+    // UI fonts are far below Tesseract's preferred x-height; doubling the
+    // resolution recovers most small labels
+    constexpr int Scale = 2;
+    const QImage scaled = image.copy(band).convertToFormat(QImage::Format_Grayscale8).scaled(band.size() * Scale, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    m_api->SetImage(scaled.constBits(), scaled.width(), scaled.height(), 1, int(scaled.bytesPerLine()));
+    m_api->SetSourceResolution(70 * Scale);
+
+    QList<Word> words;
+    if (m_api->Recognize(nullptr) != 0)
+        return words;
+    std::unique_ptr<tesseract::ResultIterator> it(m_api->GetIterator());
+    if (!it)
+        return words;
+    constexpr auto level = tesseract::RIL_WORD;
+    do {
+        std::unique_ptr<char[]> text(it->GetUTF8Text(level));
+        if (!text)
+            continue;
+        const QString word = QString::fromUtf8(text.get()).trimmed();
+        int x1, y1, x2, y2;
+        if (word.isEmpty() || !it->BoundingBox(level, &x1, &y1, &x2, &y2))
+            continue;
+        const QRect box(band.left() + x1 / Scale, band.top() + y1 / Scale,
+                        qMax(1, (x2 - x1) / Scale), qMax(1, (y2 - y1) / Scale));
+        if (!core.contains(QPoint(core.left(), box.center().y())))
+            continue;
+        words.append({ word, box, qRound(it->Confidence(level)) });
+    } while (it->Next(level));
+    return words;
+}
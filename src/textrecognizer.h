@@ -0,0 +1,73 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef TEXTRECOGNIZER_H
+#define TEXTRECOGNIZER_H
+
+#include <memory>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QtGui/QRegion>
+
+namespace tesseract {
+class TessBaseAPI;
+}
+
+// Tesseract OCR over the framebuffer. A region is recognized in horizontal
+// bands that overlap by Overlap rows; each band keeps the words whose center
+// lies in its own rows, so a line of text cut by one band is whole in the
+// next. Results are cached per band and reused while the band saw no damage
+// or, if it did, while its pixels still hash the same.
+class TextRecognizer
+{
+public:
+    struct Word
+    {
+        QString text;
+        QRect box; // framebuffer coordinates
+        int confidence; // 0-100
+    };
+
+    struct Stats
+    {
+        int bands = 0;
+        int recognized = 0;
+    };
+
+    TextRecognizer();
+    ~TextRecognizer();
+
+    // Loads the engine on first use; TESSDATA_PREFIX and MCP_VNC_OCR_LANG
+    // (default "eng") select the trained data
+    bool isReady();
+    QString errorString() const { return m_error; }
+
+    void addDamage(const QRect &rect) { m_damage += rect; }
+    void clear();
+
+    QList<Word> recognize(const QImage &image, const QRect &region, Stats *stats = nullptr);
+
+private:
+    static constexpr int BandHeight = 64;
+    static constexpr int Overlap = 32;
+
+    struct Band
+    {
+        size_t hash;
+        QList<Word> words;
+    };
+
+    static quint64 bandKey(const QRect &core);
+    QList<Word> recognizeBand(const QImage &image, const QRect &band, const QRect &core);
+
+    std::unique_ptr<tesseract::TessBaseAPI> m_api;
+    bool m_initialized = false;
+    QString m_error;
+    QHash<quint64, Band> m_bands;
+    QRegion m_damage;
+};
+
+#endif // TEXTRECOGNIZER_H
@@ -2,23 +2,58 @@
 // SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include "tools.h"
+#include "imagediff.h"
+#include "linkprobe.h"
+#include "screenshotstore.h"
+#include "sharedframebuffer.h"
+#include "stats.h"
+#ifdef HAVE_TESSERACT
+#include "textrecognizer.h"
+#endif
+#include "trace.h"
+#ifdef HAVE_WIDGETS
 #include "vncwidget.h"
+#include <QtWidgets/QApplication>
+#endif
 #include <QtVncClient/QVncClient>
 #include <QtNetwork/QTcpSocket>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QCache>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtCore/QJsonParseError>
+#include <QtCore/QMap>
+#include <QtCore/QMetaMethod>
 #include <QtCore/QPromise>
+#include <QtCore/QSet>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QSocketNotifier>
+#include <QtCore/QThreadPool>
 #include <QtCore/QTimer>
+#include <QtCore/QtEndian>
+#include <QtCore/QtMath>
 #include <QtGui/QKeyEvent>
 #include <QtGui/QMouseEvent>
 #include <QtGui/QPainter>
 #include <QtGui/QPainterPath>
+#include <QtGui/QRegion>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 #ifdef HAVE_MULTIMEDIA
 #include <QtMultimedia/QMediaCaptureSession>
 #include <QtMultimedia/QMediaFormat>
@@ -27,23 +62,340 @@
 #include <QtMultimedia/QVideoFrameInput>
 #endif
 
+struct CursorState
+{
+    QImage image;
+    QPoint pos;
+    QPoint hotspot;
+    QPointF fallbackPos; // drawn as an arrow when the server sends no shape
+};
+
+// A server-side watch on a region, checked on every update that touches it
+struct RegionWatch
+{
+    enum Condition { Change, Color, Image };
+
+    QUuid session; // notified when it fires
+    QRect rect;
+    Condition condition = Change;
+    QColor color;
+    QImage image;
+    qreal similarity = 1.0;
+    bool once = true;
+    // Pixels before the first update after registration may be stale
+    quint64 startSerial = 0;
+    bool primed = false;
+    size_t hash = 0;
+    bool met = false;
+};
+
+// A frozen frame. QImage is implicitly shared, so taking one costs nothing
+// until the live framebuffer is next written; the cursor composite is made
+// on first use and then reused.
+struct Snapshot
+{
+    QImage framebuffer;
+    CursorState cursor;
+    QImage composited;
+};
+
+#ifdef HAVE_TESSERACT
+// What a recognition job hands back from the OCR thread
+struct TextRecognition
+{
+    QList<TextRecognizer::Word> words;
+    TextRecognizer::Stats stats;
+    QString error;
+};
+#endif
+
+static QImage compositeWithCursor(const QImage &framebuffer, const CursorState &cursor);
+static QList<QMcpCallToolResultContent> imageOrError(const QImage &image);
+static QFuture<QList<QMcpCallToolResultContent>> textResult(const QString &text);
+static size_t regionHash(const QImage &image, const QRect &region);
+
+static QList<QByteArray> toolNames()
+{
+    QList<QByteArray> names;
+    const QMetaObject &mo = Tools::staticMetaObject;
+    for (int i = mo.methodOffset(); i < mo.methodCount(); ++i) {
+        const QMetaMethod method = mo.method(i);
+        if (method.methodType() == QMetaMethod::Method)
+            names.append(method.name());
+    }
+    return names;
+}
+
+// Encodings that can be requested by name, in RFB numbering. Whether the
+// VNC client decodes them is learned at run time, see RfbSocket.
+static const QList<std::pair<QLatin1String, qint32>> encodingNames = {
+    { QLatin1String("raw"), 0 },
+    { QLatin1String("copyrect"), 1 },
+    { QLatin1String("rre"), 2 },
+    { QLatin1String("hextile"), 5 },
+    { QLatin1String("zlib"), 6 },
+    { QLatin1String("tight"), 7 },
+    { QLatin1String("zrle"), 16 },
+};
+
+static bool isLevelEncoding(qint32 encoding)
+{
+    return (encoding >= -32 && encoding <= -23)      // Tight JPEG quality
+        || (encoding >= -256 && encoding <= -247);   // compression level
+}
+
+// The socket QVncClient talks through. SetEncodings replaces the whole list,
+// so every list mcp-vnc sends must stay within what the client decodes and
+// keep the pseudo-encodings it handles (RichCursor, PointerPos, DesktopSize,
+// ExtendedClipboard, ...), or rectangles arrive that the client cannot parse
+// and cursor, resize and clipboard tracking stop. The client announces both
+// in its own SetEncodings, which is picked out of what it writes: once the
+// handshake is over, the outgoing bytes are split into messages however
+// they were chunked.
+class RfbSocket : public QTcpSocket
+{
+public:
+    // Tells when the handshake is over and only messages follow
+    void setHandshakeFinished(const std::function<bool()> &finished) { m_handshakeFinished = finished; }
+
+    // The client's list, empty until it has sent one
+    const QList<qint32> &clientEncodings() const { return m_clientEncodings; }
+    bool clientEncodingsKnown() const { return m_clientEncodingsKnown; }
+    void clearClientEncodings()
+    {
+        m_clientEncodings.clear();
+        m_clientEncodingsKnown = false;
+        m_pending.clear();
+        m_skip = 0;
+        m_parsing = true;
+    }
+
+    // For messages of our own, which must not be mistaken for the client's
+    qint64 writeOwn(const QByteArray &message)
+    {
+        m_ownWrite = true;
+        const qint64 written = write(message);
+        m_ownWrite = false;
+        return written;
+    }
+
+protected:
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        if (!m_ownWrite && m_parsing && m_handshakeFinished && m_handshakeFinished())
+            parse(data, size);
+        return QTcpSocket::writeData(data, size);
+    }
+
+private:
+    // Size of the message at the front of m_pending, 0 while its header is
+    // incomplete, -1 for a type the client is not known to send
+    qint64 messageLength() const
+    {
+        const char *p = m_pending.constData();
+        const qsizetype n = m_pending.size();
+        switch (quint8(p[0])) {
+        case 0: // SetPixelFormat
+            return 20;
+        case 2: // SetEncodings
+            return n < 4 ? 0 : 4 + 4 * qint64(qFromBigEndian<quint16>(p + 2));
+        case 3: // FramebufferUpdateRequest
+            return 10;
+        case 4: // KeyEvent
+            return 8;
+        case 5: // PointerEvent
+            return 6;
+        case 6: // ClientCutText; a negative length marks Extended Clipboard
+            return n < 8 ? 0 : 8 + qAbs(qint64(qFromBigEndian<qint32>(p + 4)));
+        case 150: // EnableContinuousUpdates
+            return 10;
+        case 248: // ClientFence
+            return n < 9 ? 0 : 9 + quint8(p[8]);
+        case 251: // SetDesktopSize
+            return n < 8 ? 0 : 8 + 16 * qint64(quint8(p[6]));
+        default:
+            return -1;
+        }
+    }
+
+    // Only SetEncodings is kept whole; the payload of anything else, such as
+    // a large clipboard transfer, is skipped as it goes by
+    void parse(const char *data, qint64 size)
+    {
+        const qint64 skipped = qMin(m_skip, size);
+        m_skip -= skipped;
+        m_pending.append(data + skipped, size - skipped);
+        while (!m_pending.isEmpty()) {
+            const qint64 length = messageLength();
+            if (length < 0) {
+                // Lost track of the message boundaries; what is known stays
+                m_parsing = false;
+                m_pending.clear();
+                return;
+            }
+            if (length == 0)
+                return;
+            if (m_pending.at(0) == 2) {
+                if (m_pending.size() < length)
+                    return;
+                m_clientEncodings.clear();
+                for (qint64 offset = 4; offset < length; offset += 4)
+                    m_clientEncodings.append(qFromBigEndian<qint32>(m_pending.constData() + offset));
+                m_clientEncodingsKnown = true;
+            } else if (m_pending.size() < length) {
+                m_skip = length - m_pending.size();
+                m_pending.clear();
+                return;
+            }
+            m_pending.remove(0, length);
+        }
+    }
+
+    std::function<bool()> m_handshakeFinished;
+    QList<qint32> m_clientEncodings;
+    bool m_clientEncodingsKnown = false;
+    QByteArray m_pending;
+    qint64 m_skip = 0;
+    bool m_parsing = true;
+    bool m_ownWrite = false;
+};
+
 class Tools::Private
 {
 public:
-    QTcpSocket socket;
+    RfbSocket socket;
     QVncClient vncClient;
+    Stats stats { toolNames() };
+    // Periodic stats, per session that asked for them
+    QHash<QUuid, QTimer *> statsTimers;
+
+    // Session of the tool call being dispatched, and the sessions using the
+    // VNC connection; it is closed when the last of them disconnects
+    QUuid session;
+    QSet<QUuid> connectionSessions;
+    // Bytes QVncClient left unread after the previous readyRead
+    qint64 unreadBytes = 0;
+    QElapsedTimer decodeTimer;
+
+    // Link probe state: handshake timing and the current receive burst
+    LinkProbe link;
+    QElapsedTimer connectTimer;
+    QElapsedTimer burstTimer;
+    QElapsedTimer lastReadTimer;
+    qint64 burstBytes = 0;
+#ifdef HAVE_WIDGETS
+    // Created on the first setPreview(true), so headless runs never pay for it
     VncWidget *previewWidget = nullptr;
+#endif
     bool previewEnabled = false;
+    // Preview settings, applied when the window is created
+    QString previewTitle;
+    bool previewInteractive = false;
+    bool previewStaysOnTop = false;
+    int previewFrameRate = 30;
+    bool previewScaled = false;
+
+    // Post-input burst: a screenshot almost always follows an input action,
+    // so updates stay on for a while to have the framebuffer current by then.
+    // A window of -1 follows the link profile, 0 disables the burst.
+    QTimer inputBurstTimer;
+    int inputBurstWindow = -1;
+    // An update has arrived since updates were last enabled
+    bool framebufferCurrent = false;
+
+    // Tools that need updates flowing hold a reference; updates turn off once
+    // the last hold is released and nothing else needs them.
+    int updateHolds = 0;
+
+    // Single-flight refresh awaited by every reader that needs a current frame
+    struct RefreshWaiter
+    {
+        quint64 id;
+        std::function<void()> onRefreshed;
+    };
+    QList<RefreshWaiter> refreshWaiters;
+    quint64 lastRefreshWaiter = 0;
+    QElapsedTimer refreshTimer;
+    bool refreshHasImageData = false;
     bool wasConnected = false;
     QPointF pos;
+    // Set while connected over a Unix-domain socket
+    QString socketPath;
+    // Encoding preference sent after the handshake, empty for the client's own
+    QList<qint32> encodings;
+    // An update has arrived on this connection, so RFB messages may be sent
+    bool sessionReady = false;
+
+    // Reduced quality: Tight JPEG at this quality (0-9) while nothing needs
+    // exact pixels, -1 to keep every update lossless
+    int reducedQuality = -1;
+    bool lossyActive = false;
+    // Lossy pixels may remain until a full-screen lossless update lands
+    bool lossyPixels = false;
+    QRegion updateRegion;
+
+    // Incremental requests sent on top of QVncClient's own, so the server
+    // has one pending while the previous update is still on the wire. -1
+    // follows the link profile, 0 disables.
+    int pipelineDepth = -1;
+    int pipelinedRequests = 0;
+
+    // Regions watched by waits, one entry per reference. While nothing needs
+    // the whole screen, updates are requested for their bounding rectangle
+    // only and QVncClient's own full-screen requests stay off.
+    QList<QRect> regionsOfInterest;
+    bool regionRequested = false;
+    // Counts framebuffer updates, so waits can tell fresh pixels from old
+    quint64 updateSerial = 0;
+
+    // Region watches by handle, with the damage of the update in progress
+    QMap<QString, RegionWatch> watches;
+    int watchSerial = 0;
+    QRegion watchDamage;
+
+    // Snapshots by handle, evicted least recently used first. The cost
+    // counts the frame and its lazily made cursor composite.
+    static constexpr qsizetype SnapshotBudget = 256 * 1024 * 1024;
+    QCache<QString, Snapshot> snapshots { SnapshotBudget };
+    int snapshotSerial = 0;
+
+    // Shared memory export for co-located readers, fed with the damage
+    // collected between framebuffer updates
+    SharedFramebuffer sharedFramebuffer;
+    QList<QRect> sharedDamage;
 
     // Clipboard buffer — captures data that arrives between MCP tool calls
     QString lastClipboardText;
     QImage lastClipboardImage;
+    // Payloads above the buffer limit are not kept between calls; results
+    // above the inline limit must go to a file
+    qint64 clipboardInlineLimit = 1024 * 1024;
+    qint64 clipboardBufferLimit = 64 * 1024 * 1024;
+
+#ifdef HAVE_TESSERACT
+    // A Tesseract pass over a full screen takes long enough to stall the
+    // socket and every other tool, so it runs on a thread of its own. The
+    // recognizer and its band cache are only touched there; damage collects
+    // here and goes along with each job.
+    TextRecognizer textRecognizer;
+    QThreadPool ocrPool;
+    QRegion ocrDamage;
+    bool ocrReset = false;
+#endif
+
+    // Deduplicating archive for save, off unless setScreenshotStore is called
+    ScreenshotStore screenshotStore;
+
+    // Last golden image, reused while the file is unchanged
+    QString goldenPath;
+    QDateTime goldenModified;
+    QImage golden;
 
     // Macro members
     QString macroDir;
     bool macroPlaying = false;
+    std::function<void()> cancelMacro;
+    QFuture<QList<QMcpCallToolResultContent>> macroStepFuture;
 
 #ifdef HAVE_MULTIMEDIA
     // Recording members
@@ -56,13 +408,384 @@ public:
     int recordingFps = 10;
 #endif
 
+#ifdef HAVE_WIDGETS
+    // Needs a QApplication; --headless runs on QCoreApplication
+    bool createPreviewWidget()
+    {
+        if (previewWidget)
+            return true;
+        if (!qobject_cast<QApplication *>(QCoreApplication::instance()))
+            return false;
+        previewWidget = new VncWidget;
+        previewWidget->setClient(&vncClient);
+        previewWidget->setWindowTitle(previewTitle.isEmpty() ? QCoreApplication::applicationName() : previewTitle);
+        previewWidget->setInteractive(previewInteractive);
+        previewWidget->setWindowFlag(Qt::WindowStaysOnTopHint, previewStaysOnTop);
+        previewWidget->setMaximumFrameRate(previewFrameRate);
+        previewWidget->setScaledToFit(previewScaled);
+        QObject::connect(previewWidget, &VncWidget::closed, previewWidget, [this]() {
+            previewEnabled = false;
+            updateFramebufferUpdates();
+        });
+        return true;
+    }
+#endif
+
     void updateFramebufferUpdates()
     {
-        bool needed = previewEnabled;
+        bool needed = previewEnabled || inputBurstTimer.isActive() || updateHolds > 0;
 #ifdef HAVE_MULTIMEDIA
         needed = needed || recording;
 #endif
+        if (!needed)
+            framebufferCurrent = false;
         vncClient.setFramebufferUpdatesEnabled(needed);
+        updateEncodingMode();
+        pipelineRequests();
+        requestRegions();
+    }
+
+    void acquireRegion(const QRect &rect)
+    {
+        regionsOfInterest.append(rect);
+        // The region may be stale: ask for all of it once, then for changes
+        if (sessionReady && !vncClient.framebufferUpdatesEnabled())
+            requestUpdate(false, rect);
+        updateFramebufferUpdates();
+    }
+
+    void releaseRegion(const QRect &rect)
+    {
+        regionsOfInterest.removeOne(rect);
+        updateFramebufferUpdates();
+    }
+
+    // Keeps one incremental request for the regions' bounding rectangle in
+    // flight while nothing needs full-screen updates
+    void requestRegions()
+    {
+        if (regionRequested || regionsOfInterest.isEmpty() || !sessionReady
+            || vncClient.framebufferUpdatesEnabled())
+            return;
+        QRect bounds;
+        for (const QRect &rect : std::as_const(regionsOfInterest))
+            bounds |= rect;
+        requestUpdate(true, bounds);
+        regionRequested = true;
+    }
+
+    // True when the local framebuffer tracks the server without a refresh
+    bool framebufferLive() const
+    {
+        return vncClient.framebufferUpdatesEnabled() && framebufferCurrent;
+    }
+
+    // True when the local framebuffer can be handed out as exact pixels
+    bool framebufferExact() const
+    {
+        return framebufferLive() && !lossyActive && !lossyPixels;
+    }
+
+    // Lossy while only change detection, waits or the preview consume frames.
+    // A pending refresh or an input burst (a screenshot is likely next)
+    // switches back, and a non-incremental request replaces the lossy pixels.
+    void updateEncodingMode()
+    {
+        const bool lossy = reducedQuality >= 0 && sessionReady && clientDecodes(7) && refreshWaiters.isEmpty()
+            && !inputBurstTimer.isActive()
+            && std::all_of(watches.cbegin(), watches.cend(), [](const RegionWatch &watch) {
+                   return watch.condition == RegionWatch::Change;
+               });
+        if (lossy == lossyActive)
+            return;
+        lossyActive = lossy;
+        if (lossy) {
+            writeEncodings(clientEncodingList({ 7, -32 + reducedQuality, 0 })); // tight, quality, raw
+            lossyPixels = true;
+            return;
+        }
+        // Without a preference of its own the client's list is restored as is
+        writeEncodings(encodings.isEmpty() ? socket.clientEncodings() : clientEncodingList(encodings));
+        updateRegion = QRegion();
+        requestUpdate(false);
+    }
+
+    // Tops up the pipeline after each update. Servers merge pending
+    // incremental requests into one requested region (libvncserver and
+    // TigerVNC do), so the extra requests do not pile up.
+    void pipelineRequests()
+    {
+        if (!sessionReady || !vncClient.framebufferUpdatesEnabled())
+            return;
+        const int depth = pipelineDepth < 0 ? link.requestPipelineDepth() : pipelineDepth;
+        for (; pipelinedRequests < depth; ++pipelinedRequests)
+            requestUpdate(true);
+    }
+
+    void inputSent()
+    {
+        const int window = inputBurstWindow < 0 ? link.inputBurstWindow() : inputBurstWindow;
+        if (window <= 0 || socket.state() != QTcpSocket::ConnectedState)
+            return;
+        inputBurstTimer.start(window);
+        updateFramebufferUpdates();
+    }
+
+    void acquireUpdates()
+    {
+        ++updateHolds;
+        updateFramebufferUpdates();
+    }
+
+    void releaseUpdates()
+    {
+        Q_ASSERT(updateHolds > 0);
+        --updateHolds;
+        updateFramebufferUpdates();
+    }
+
+    // Calls onRefreshed once an update carrying pixel data (not just a cursor
+    // change) has arrived. Readers arriving while a refresh is in flight join
+    // it instead of requesting another. Returns the waiter's id for
+    // leaveRefresh().
+    quint64 refresh(std::function<void()> onRefreshed)
+    {
+        const quint64 id = ++lastRefreshWaiter;
+        refreshWaiters.append({ id, std::move(onRefreshed) });
+        if (refreshWaiters.size() == 1) {
+            refreshTimer.start();
+            refreshHasImageData = false;
+            acquireUpdates();
+        }
+        return id;
+    }
+
+    // Withdraws a waiter that is no longer interested; the refresh goes on
+    // for the others and releases its hold once none are left. Waiters that
+    // already ran are ignored.
+    void leaveRefresh(quint64 id)
+    {
+        const qsizetype removed = refreshWaiters.removeIf([id](const RefreshWaiter &waiter) {
+            return waiter.id == id;
+        });
+        if (removed > 0 && refreshWaiters.isEmpty())
+            releaseUpdates();
+    }
+
+    void finishRefresh(bool refreshed)
+    {
+        if (refreshed) {
+            const qint64 elapsed = refreshTimer.nsecsElapsed();
+            // Spans many event-loop turns, overlapping tool and decode spans
+            Tracer::instance()->async("refresh", "frame", elapsed);
+            link.addUpdateLatencySample(elapsed);
+        }
+        const auto waiters = std::exchange(refreshWaiters, {});
+        releaseUpdates();
+        for (const auto &waiter : waiters)
+            waiter.onRefreshed();
+    }
+
+    // Runs cleanup if the request behind future is canceled before it
+    // finishes, so abandoned waits release their timers and update holds
+    // immediately instead of at their timeout. cleanup must finish the promise.
+    // The notice is queued: a request that finished on its own in between has
+    // already cleaned up and is left alone.
+    void onCanceled(const QFuture<QList<QMcpCallToolResultContent>> &future, QObject *context, std::function<void()> cleanup)
+    {
+        auto *watcher = new QFutureWatcher<QList<QMcpCallToolResultContent>>(context);
+        QObject::connect(watcher, &QFutureWatcherBase::canceled, context, [watcher, cleanup = std::move(cleanup)]() {
+            if (!watcher->isFinished())
+                cleanup();
+        });
+        QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+        watcher->setFuture(future);
+    }
+
+    // refresh() on behalf of a tool call; canceling the call leaves the refresh
+    void refreshFor(const QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>> &promise, QObject *context,
+                    std::function<void()> onRefreshed)
+    {
+        const quint64 waiter = refresh(std::move(onRefreshed));
+        onCanceled(promise->future(), context, [this, promise, waiter]() {
+            leaveRefresh(waiter);
+            promise->finish();
+        });
+    }
+
+    bool stopMacro()
+    {
+        if (!cancelMacro)
+            return false;
+        const auto cancel = std::exchange(cancelMacro, nullptr);
+        cancel();
+        return true;
+    }
+
+    // Takes an update hold and runs fn once updates are flowing. When they
+    // were off, the full refresh that enabling them triggers is awaited first
+    // so callers watching for damage do not mistake it for a reaction to
+    // their input. The caller must balance this with releaseUpdates(), and
+    // if it gives up early, with leaveRefresh() on the returned waiter (0 when
+    // fn ran right away).
+    quint64 withLiveUpdates(std::function<void()> fn)
+    {
+        acquireUpdates();
+        if (framebufferLive()) {
+            fn();
+            return 0;
+        }
+        return refresh(std::move(fn));
+    }
+
+    // Set once the session is up but no SetEncodings from the client was seen
+    QString unknownClientEncodingsError() const
+    {
+        if (!sessionReady || socket.clientEncodingsKnown())
+            return {};
+        return QStringLiteral("Error: the VNC client's encodings are unknown, no SetEncodings message from it was seen");
+    }
+
+    // Raw needs no announcement
+    bool clientDecodes(qint32 encoding) const
+    {
+        return encoding == 0 || socket.clientEncodings().contains(encoding);
+    }
+
+    // preferred restricted to what the client decodes, plus the client's own
+    // pseudo-encodings; quality and compression levels come from preferred
+    QList<qint32> clientEncodingList(const QList<qint32> &preferred) const
+    {
+        QList<qint32> list;
+        for (qint32 encoding : preferred) {
+            if (encoding < 0 || clientDecodes(encoding))
+                list.append(encoding);
+        }
+        for (qint32 encoding : socket.clientEncodings()) {
+            if (encoding < 0 && !isLevelEncoding(encoding))
+                list.append(encoding);
+        }
+        return list;
+    }
+
+    // Sends the caller's preference. While reduced quality is active it is
+    // held back and takes effect on the switch to lossless.
+    void sendEncodings()
+    {
+        if (encodings.isEmpty() || lossyActive)
+            return;
+        writeEncodings(clientEncodingList(encodings));
+    }
+
+    // Runs fn once the local framebuffer holds exact, current pixels, unless
+    // the tool call behind promise is canceled first
+    void withExactFrame(const QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>> &promise, QObject *context,
+                        std::function<void()> fn)
+    {
+        if (framebufferExact() || socket.state() != QTcpSocket::ConnectedState)
+            fn();
+        else
+            refreshFor(promise, context, std::move(fn));
+    }
+
+#ifdef HAVE_TESSERACT
+    // Recognizes region of the current frame on the OCR thread. The frame is
+    // shared, not copied, until the next update writes to it.
+    QFuture<TextRecognition> recognizeText(const QRect &region)
+    {
+        const QImage image = vncClient.image();
+        const QRegion damage = std::exchange(ocrDamage, QRegion());
+        const bool reset = std::exchange(ocrReset, false);
+        return QtConcurrent::run(&ocrPool, [recognizer = &textRecognizer, image, region, damage, reset]() {
+            TextRecognition recognition;
+            if (reset)
+                recognizer->clear();
+            for (const QRect &rect : damage)
+                recognizer->addDamage(rect);
+            if (!recognizer->isReady()) {
+                recognition.error = recognizer->errorString();
+                return recognition;
+            }
+            recognition.words = recognizer->recognize(image, region, &recognition.stats);
+            return recognition;
+        });
+    }
+#endif
+
+    // RFB SetEncodings. Servers do not acknowledge it; the new preference
+    // applies from the next framebuffer update.
+    void writeEncodings(const QList<qint32> &list)
+    {
+        if (socket.state() != QTcpSocket::ConnectedState)
+            return;
+        QByteArray message(4 + 4 * list.size(), Qt::Uninitialized);
+        uchar *data = reinterpret_cast<uchar *>(message.data());
+        data[0] = 2; // SetEncodings
+        data[1] = 0;
+        qToBigEndian(quint16(list.size()), data + 2);
+        for (qsizetype i = 0; i < list.size(); ++i)
+            qToBigEndian(list.at(i), data + 4 + 4 * i);
+        socket.writeOwn(message);
+    }
+
+    // RFB FramebufferUpdateRequest, for the whole screen by default
+    void requestUpdate(bool incremental, const QRect &rect = QRect())
+    {
+        if (socket.state() != QTcpSocket::ConnectedState)
+            return;
+        const QRect screen(0, 0, vncClient.framebufferWidth(), vncClient.framebufferHeight());
+        const QRect area = rect.isNull() ? screen : rect & screen;
+        if (area.isEmpty())
+            return;
+        uchar data[10];
+        data[0] = 3; // FramebufferUpdateRequest
+        data[1] = incremental ? 1 : 0;
+        qToBigEndian(quint16(area.x()), data + 2);
+        qToBigEndian(quint16(area.y()), data + 4);
+        qToBigEndian(quint16(area.width()), data + 6);
+        qToBigEndian(quint16(area.height()), data + 8);
+        socket.write(reinterpret_cast<const char *>(data), sizeof(data));
+    }
+
+    QString target() const
+    {
+        if (!socketPath.isEmpty())
+            return socketPath;
+        return QStringLiteral("%1:%2").arg(socket.peerName()).arg(socket.peerPort());
+    }
+
+    CursorState cursorState() const
+    {
+        return { vncClient.cursorImage(), vncClient.cursorPos(), vncClient.cursorHotspot(), pos };
+    }
+
+    QImage composite(const QImage &framebuffer)
+    {
+        return composite(framebuffer, cursorState());
+    }
+
+    QImage composite(const QImage &framebuffer, const CursorState &cursor)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        QImage result = compositeWithCursor(framebuffer, cursor);
+        const qint64 elapsed = timer.nsecsElapsed();
+        stats.compositeTime.record(elapsed);
+        Tracer::instance()->complete("compositeWithCursor", "frame", elapsed);
+        return result;
+    }
+
+    QList<QMcpCallToolResultContent> imageResult(const QImage &image)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        QList<QMcpCallToolResultContent> content = imageOrError(image);
+        if (!image.isNull()) {
+            const qint64 elapsed = timer.nsecsElapsed();
+            stats.encodeTime.record(elapsed);
+            Tracer::instance()->complete("encode", "frame", elapsed);
+        }
+        return content;
     }
 };
 
@@ -70,7 +793,128 @@ Tools::Tools(QObject *parent)
     : QObject(parent)
     , d(new Private)
 {
+#ifdef HAVE_TESSERACT
+    // One thread keeps jobs ordered and the recognizer single-threaded
+    d->ocrPool.setMaxThreadCount(1);
+#endif
+    // Bracket QVncClient's own readyRead handler: the slot connected before
+    // setSocket() sees the bytes about to be consumed, the one connected after
+    // it measures how long decoding them took.
+    QObject::connect(&d->socket, &QTcpSocket::readyRead, this, [this]() {
+        const qint64 bytes = d->socket.bytesAvailable() - d->unreadBytes;
+        d->stats.addBytesReceived(bytes);
+        d->decodeTimer.start();
+        // A pause in arrivals means the link was idle, not slow
+        if (!d->burstTimer.isValid() || d->lastReadTimer.hasExpired(200)) {
+            d->burstTimer.start();
+            d->burstBytes = 0;
+        }
+        d->burstBytes += bytes;
+        d->lastReadTimer.start();
+    });
     d->vncClient.setSocket(&d->socket);
+    // ServerInit sets the size; the client's messages start right after it
+    d->socket.setHandshakeFinished([this]() {
+        return d->vncClient.framebufferWidth() > 0;
+    });
+    QObject::connect(&d->socket, &QTcpSocket::readyRead, this, [this]() {
+        d->unreadBytes = d->socket.bytesAvailable();
+        if (d->decodeTimer.isValid()) {
+            const qint64 elapsed = d->decodeTimer.nsecsElapsed();
+            d->stats.decodeTime.record(elapsed);
+            Tracer::instance()->complete("decode", "frame", elapsed);
+        }
+        d->decodeTimer.invalidate();
+    });
+    QObject::connect(&d->socket, &QTcpSocket::bytesWritten, this, [this](qint64 bytes) {
+        d->stats.addBytesSent(bytes);
+    });
+    QObject::connect(&d->socket, &QTcpSocket::disconnected, this, [this]() {
+        d->unreadBytes = 0;
+        d->burstTimer.invalidate();
+        d->inputBurstTimer.stop();
+        d->framebufferCurrent = false;
+        d->socketPath.clear();
+        d->connectionSessions.clear();
+        d->sessionReady = false;
+        d->socket.clearClientEncodings();
+        d->lossyActive = false;
+        d->lossyPixels = false;
+        d->pipelinedRequests = 0;
+        d->regionRequested = false;
+#ifdef HAVE_TESSERACT
+        d->ocrDamage = QRegion();
+        d->ocrReset = true;
+#endif
+        // Watches describe this session's screen; the disconnect notice ends them
+        for (const RegionWatch &watch : std::as_const(d->watches))
+            d->releaseRegion(watch.rect);
+        d->watches.clear();
+        d->watchDamage = QRegion();
+        // Readers waiting for a refresh get the last frame rather than hang
+        if (!d->refreshWaiters.isEmpty())
+            d->finishRefresh(false);
+    });
+    // TCP handshake time (after name resolution) is one clean RTT sample
+    QObject::connect(&d->socket, &QTcpSocket::hostFound, this, [this]() {
+        d->connectTimer.start();
+    });
+    QObject::connect(&d->socket, &QTcpSocket::connected, this, [this]() {
+        if (d->connectTimer.isValid())
+            d->link.addRttSample(d->connectTimer.nsecsElapsed());
+        d->connectTimer.invalidate();
+    });
+    QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this, [this]() {
+        d->framebufferCurrent = true;
+        if (!std::exchange(d->sessionReady, true))
+            d->updateEncodingMode();
+        ++d->updateSerial;
+        if (d->pipelinedRequests > 0)
+            --d->pipelinedRequests;
+        d->pipelineRequests();
+        d->regionRequested = false;
+        d->requestRegions();
+        if (!d->watches.isEmpty())
+            evaluateWatches();
+        // The reply to the non-incremental request covers the whole screen
+        if (d->lossyPixels && !d->lossyActive) {
+            const QRegion screen(QRect(QPoint(0, 0), d->vncClient.image().size()));
+            if ((screen - d->updateRegion).isEmpty())
+                d->lossyPixels = false;
+            d->updateRegion = QRegion();
+        }
+        d->stats.addFramebufferUpdate();
+        Tracer::instance()->instant("framebufferUpdated", "frame");
+        // Small updates finish within one read and say nothing about bandwidth
+        if (d->burstTimer.isValid() && d->burstBytes >= 16384)
+            d->link.addTransferSample(d->burstBytes, d->burstTimer.nsecsElapsed());
+        d->burstTimer.invalidate();
+
+        if (d->sharedFramebuffer.isActive() && !d->sharedDamage.isEmpty()) {
+            d->sharedFramebuffer.publish(d->vncClient.image(), d->sharedDamage);
+            d->sharedDamage.clear();
+        }
+
+        if (!d->refreshWaiters.isEmpty() && d->refreshHasImageData && !d->lossyPixels)
+            d->finishRefresh(true);
+    });
+    QObject::connect(&d->vncClient, &QVncClient::imageChanged, this, [this](const QRect &rect) {
+        if (!d->refreshWaiters.isEmpty())
+            d->refreshHasImageData = true;
+        if (d->lossyPixels && !d->lossyActive)
+            d->updateRegion += rect;
+#ifdef HAVE_TESSERACT
+        d->ocrDamage += rect;
+#endif
+        if (!d->watches.isEmpty())
+            d->watchDamage += rect;
+        if (d->sharedFramebuffer.isActive())
+            d->sharedDamage.append(rect);
+    });
+    d->inputBurstTimer.setSingleShot(true);
+    QObject::connect(&d->inputBurstTimer, &QTimer::timeout, this, [this]() {
+        d->updateFramebufferUpdates();
+    });
     d->vncClient.setFramebufferUpdatesEnabled(false);
     QObject::connect(&d->vncClient, &QVncClient::connectionStateChanged, this, [this](bool connected) {
         if (!connected && d->wasConnected) {
@@ -79,29 +923,42 @@ Tools::Tools(QObject *parent)
             emit disconnected();
         }
         d->wasConnected = connected;
+#ifdef HAVE_WIDGETS
         if (!d->previewWidget)
             return;
         if (connected && d->previewEnabled)
             d->previewWidget->show();
         else if (!connected)
             d->previewWidget->hide();
+#endif
     });
     QObject::connect(&d->vncClient, &QVncClient::cursorPosChanged, this, [this](const QPoint &pos) {
         d->pos = QPointF(pos);
     });
     QObject::connect(&d->vncClient, &QVncClient::clipboardTextReceived, this, [this](const QString &text) {
-        d->lastClipboardText = text;
+        if (qint64(text.size()) * qint64(sizeof(QChar)) <= d->clipboardBufferLimit)
+            d->lastClipboardText = text;
+        else
+            d->lastClipboardText.clear();
     });
     QObject::connect(&d->vncClient, &QVncClient::clipboardImageReceived, this, [this](const QImage &image) {
-        d->lastClipboardImage = image;
+        if (image.sizeInBytes() <= d->clipboardBufferLimit)
+            d->lastClipboardImage = image;
+        else
+            d->lastClipboardImage = QImage();
     });
 }
 
 Tools::~Tools()
 {
 #ifdef HAVE_MULTIMEDIA
-    if (d->recording)
+    if (d->recording) {
+        const Stats::Internal internal(d->stats);
         stopRecording();
+    }
+#endif
+#ifdef HAVE_WIDGETS
+    delete d->previewWidget;
 #endif
 }
 
@@ -110,19 +967,165 @@ QVncClient *Tools::client() const
     return &d->vncClient;
 }
 
-void Tools::setPreviewWidget(VncWidget *widget)
+static QString encodingName(qint32 encoding)
+{
+    const auto it = std::find_if(encodingNames.cbegin(), encodingNames.cend(), [encoding](const auto &entry) {
+        return encoding == entry.second;
+    });
+    return it != encodingNames.cend() ? QString(it->first) : QString::number(encoding);
+}
+
+// Builds a SetEncodings preference from a comma-separated order plus the
+// Tight JPEG quality (0-9) and zlib compression level (0-9) pseudo-encodings.
+// Raw is always appended as the universal fallback. decodable rejects what
+// the client cannot decode; without one (before the handshake) the list is
+// filtered when it is sent.
+static bool parseEncodings(const QString &list, int quality, int compression,
+                           const std::function<bool(qint32)> &decodable, QList<qint32> *encodings, QString *error)
+{
+    encodings->clear();
+    const QStringList names = list.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &name : names) {
+        const QString key = name.trimmed().toLower();
+        const auto it = std::find_if(encodingNames.cbegin(), encodingNames.cend(), [&key](const auto &entry) {
+            return key == entry.first;
+        });
+        if (it == encodingNames.cend()) {
+            *error = QStringLiteral("Error: unknown encoding '%1'").arg(name.trimmed());
+            return false;
+        }
+        if (decodable && !decodable(it->second)) {
+            *error = QStringLiteral("Error: the VNC client cannot decode '%1'").arg(name.trimmed());
+            return false;
+        }
+        if (!encodings->contains(it->second))
+            encodings->append(it->second);
+    }
+    if (encodings->isEmpty()) {
+        *error = QStringLiteral("Error: no encodings given");
+        return false;
+    }
+    if (!encodings->contains(0))
+        encodings->append(0);
+    if (quality >= 0)
+        encodings->append(-32 + qMin(quality, 9));
+    if (compression >= 0)
+        encodings->append(-256 + qMin(compression, 9));
+    return true;
+}
+
+static QJsonObject encodingsJson(const QList<qint32> &encodings)
 {
-    d->previewWidget = widget;
-    if (widget) {
-        QObject::connect(widget, &VncWidget::closed, this, [this]() {
-            d->previewEnabled = false;
-            d->updateFramebufferUpdates();
+    QJsonArray names;
+    int quality = -1;
+    int compression = -1;
+    for (qint32 encoding : encodings) {
+        const auto it = std::find_if(encodingNames.cbegin(), encodingNames.cend(), [encoding](const auto &entry) {
+            return encoding == entry.second;
         });
+        if (it != encodingNames.cend())
+            names.append(QString(it->first));
+        else if (encoding >= -32 && encoding <= -23)
+            quality = encoding + 32;
+        else if (encoding >= -256 && encoding <= -247)
+            compression = encoding + 256;
+    }
+    QJsonObject obj;
+    obj[QStringLiteral("encodings")] = names;
+    obj[QStringLiteral("quality")] = quality;
+    obj[QStringLiteral("compression")] = compression;
+    return obj;
+}
+
+#ifdef Q_OS_UNIX
+// Makes a non-blocking stream socket for a Unix-domain path and its address.
+// Connecting can still wait, e.g. while the listener's backlog is full, so
+// it is driven from the event loop, see Tools::connect.
+static int openUnixSocket(const QString &path, sockaddr_un *addr, QString *error)
+{
+    const QByteArray encoded = QFile::encodeName(path);
+    *addr = {};
+    addr->sun_family = AF_UNIX;
+    if (size_t(encoded.size()) >= sizeof(addr->sun_path)) {
+        *error = QStringLiteral("Error: socket path '%1' is too long").arg(path);
+        return -1;
     }
+    std::memcpy(addr->sun_path, encoded.constData(), encoded.size());
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::fcntl(fd, F_SETFD, FD_CLOEXEC) < 0
+        || ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        *error = QStringLiteral("Error: %1").arg(qt_error_string(errno));
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+void Tools::setSession(const QUuid &session)
+{
+    d->session = session;
+}
+
+// A client that goes away no longer holds the connection open and gets no
+// further reports
+void Tools::detachSession(const QUuid &session)
+{
+    delete d->statsTimers.take(session);
+    d->watches.removeIf([this, &session](QMap<QString, RegionWatch>::iterator it) {
+        if (it->session != session)
+            return false;
+        d->releaseRegion(it->rect);
+        return true;
+    });
+    if (d->connectionSessions.remove(session) && d->connectionSessions.isEmpty())
+        d->socket.disconnectFromHost();
 }
 
-QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, int port, const QString &password, const QString &username, int timeout)
+QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, int port, const QString &password, const QString &username, int timeout, const QString &encodings, int quality, int compression)
 {
+    auto call = d->stats.call("connect");
+    const QUuid session = d->session;
+    // A host that is an absolute path names a Unix-domain socket
+    const bool unixSocket = host.startsWith(QLatin1Char('/'));
+
+    // Several MCP clients may share one process: attaching to the target that
+    // is already connected reuses its session instead of handshaking again
+    if (d->socket.state() == QTcpSocket::ConnectedState) {
+        const bool sameTarget = unixSocket ? d->socketPath == host
+                                           : d->socketPath.isEmpty() && d->socket.peerName() == host && d->socket.peerPort() == port;
+        if (sameTarget && d->vncClient.framebufferWidth() > 0) {
+            d->connectionSessions.insert(session);
+            const Stats::Internal internal(d->stats);
+            return textResult(status());
+        }
+        return textResult(QStringLiteral("Error: already connected to %1; disconnect first").arg(d->target()));
+    }
+
+    QList<qint32> encodingList;
+    if (!encodings.isEmpty()) {
+        QString error;
+        if (!parseEncodings(encodings, quality, compression, {}, &encodingList, &error))
+            return textResult(error);
+    }
+    d->encodings = encodingList;
+
+    int fd = -1;
+#ifdef Q_OS_UNIX
+    sockaddr_un addr;
+#endif
+    if (unixSocket) {
+#ifdef Q_OS_UNIX
+        QString error;
+        fd = openUnixSocket(host, &addr, &error);
+        if (fd < 0)
+            return textResult(error);
+#else
+        return textResult(QStringLiteral("Error: Unix-domain sockets are not supported on this platform"));
+#endif
+    }
     if (!password.isEmpty())
         d->vncClient.setPassword(password);
     if (!username.isEmpty())
@@ -135,32 +1138,70 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, in
     auto connFb = QSharedPointer<QMetaObject::Connection>::create();
     auto connErr = QSharedPointer<QMetaObject::Connection>::create();
     auto connDisc = QSharedPointer<QMetaObject::Connection>::create();
+    auto holding = QSharedPointer<bool>::create(false);
     auto timer = new QTimer(this);
     timer->setSingleShot(true);
+    // Drives a Unix-domain connect; the descriptor is closed unless adopted
+    auto connector = unixSocket ? new QObject(this) : nullptr;
+    auto pendingFd = QSharedPointer<int>::create(fd);
 
-    auto cleanup = [connTcp, connFb, connErr, connDisc, timer]() {
+    auto cleanup = [this, connTcp, connFb, connErr, connDisc, holding, timer, connector, pendingFd]() {
         QObject::disconnect(*connTcp);
         QObject::disconnect(*connFb);
         QObject::disconnect(*connErr);
         QObject::disconnect(*connDisc);
         timer->stop();
         timer->deleteLater();
+        if (connector) {
+            // Its notifier must not watch the descriptor past the close
+            const auto notifiers = connector->findChildren<QSocketNotifier *>();
+            for (QSocketNotifier *notifier : notifiers)
+                notifier->setEnabled(false);
+            connector->deleteLater();
+        }
+#ifdef Q_OS_UNIX
+        if (*pendingFd >= 0)
+            ::close(std::exchange(*pendingFd, -1));
+#endif
+        if (std::exchange(*holding, false))
+            d->releaseUpdates();
     };
 
     // Wait for TCP connection before enabling framebuffer updates.
     // Enabling before connected triggers QVncClient read() on an unconnected socket → SIGSEGV.
     *connTcp = QObject::connect(&d->socket, &QTcpSocket::connected, this,
-        [this]() {
-            d->vncClient.setFramebufferUpdatesEnabled(true);
+        [this, holding]() {
+            *holding = true;
+            d->acquireUpdates();
         });
 
     // Wait for the first framebuffer update (handshake complete + pixel data received)
     *connFb = QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this,
-        [this, promise, cleanup]() {
+        [this, promise, cleanup, session]() {
             cleanup();
-            d->updateFramebufferUpdates();
+            d->connectionSessions.insert(session);
+            // The client has announced what it decodes by now
+            const QString unknown = d->unknownClientEncodingsError();
+            const bool dropped = !unknown.isEmpty() && !d->encodings.isEmpty();
+            if (dropped)
+                d->encodings.clear();
+            QStringList ignored;
+            d->encodings.removeIf([this, &ignored](qint32 encoding) {
+                if (encoding < 0 || d->clientDecodes(encoding))
+                    return false;
+                ignored.append(encodingName(encoding));
+                return true;
+            });
+            // Sent after the client's own SetEncodings so it takes precedence
+            d->sendEncodings();
+            const Stats::Internal internal(d->stats);
+            QString text = status();
+            if (!ignored.isEmpty())
+                text += QStringLiteral("\nIgnored encodings the VNC client cannot decode: %1").arg(ignored.join(QStringLiteral(", ")));
+            if (dropped)
+                text += QStringLiteral("\n%1; the requested encodings were not applied").arg(unknown);
             QList<QMcpCallToolResultContent> content;
-            content.append(QMcpCallToolResultContent(QMcpTextContent(status())));
+            content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
             promise->addResult(content);
             promise->finish();
         });
@@ -169,7 +1210,6 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, in
     *connErr = QObject::connect(&d->socket, &QTcpSocket::errorOccurred, this,
         [this, promise, cleanup](QAbstractSocket::SocketError) {
             cleanup();
-            d->updateFramebufferUpdates();
             QList<QMcpCallToolResultContent> content;
             content.append(QMcpCallToolResultContent(QMcpTextContent(
                 QStringLiteral("Error: %1").arg(d->socket.errorString()))));
@@ -181,7 +1221,6 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, in
     *connDisc = QObject::connect(&d->socket, &QTcpSocket::disconnected, this,
         [this, promise, cleanup]() {
             cleanup();
-            d->updateFramebufferUpdates();
             QList<QMcpCallToolResultContent> content;
             content.append(QMcpCallToolResultContent(QMcpTextContent(
                 QStringLiteral("Error: disconnected during handshake"))));
@@ -191,28 +1230,157 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::connect(const QString &host, in
 
     // Handle connection timeout
     QObject::connect(timer, &QTimer::timeout, this,
-        [this, promise, cleanup, host, port]() {
+        [this, promise, cleanup, unixSocket, host, port]() {
             cleanup();
             d->socket.abort();
-            d->updateFramebufferUpdates();
             QList<QMcpCallToolResultContent> content;
             content.append(QMcpCallToolResultContent(QMcpTextContent(
-                QStringLiteral("Error: connection to %1:%2 timed out").arg(host).arg(port))));
+                QStringLiteral("Error: connection to %1 timed out")
+                    .arg(unixSocket ? host : QStringLiteral("%1:%2").arg(host).arg(port)))));
             promise->addResult(content);
             promise->finish();
         });
-    timer->start(timeout);
 
-    d->socket.connectToHost(host, port);
-    return promise->future();
-}
+    d->onCanceled(promise->future(), this, [this, promise, cleanup]() {
+        cleanup();
+        d->socket.abort();
+        promise->finish();
+    });
 
-void Tools::disconnect()
-{
-    d->socket.disconnectFromHost();
-}
+    timer->start(timeout);
 
-static QImage extractRegion(const QImage &image, int x, int y, int width, int height)
+    d->link.reset();
+    d->socket.clearClientEncodings();
+    if (fd < 0) {
+        d->socket.connectToHost(host, port);
+        return call.track(promise->future());
+    }
+
+#ifdef Q_OS_UNIX
+    auto fail = [promise, cleanup](const QString &error) {
+        cleanup();
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(error)));
+        promise->addResult(content);
+        promise->finish();
+    };
+
+    // An adopted descriptor is already connected and emits no connected()
+    QElapsedTimer connectTimer;
+    connectTimer.start();
+    auto waited = QSharedPointer<bool>::create(false);
+    auto adopt = [this, host, holding, pendingFd, fail, connectTimer, waited]() {
+        // Waiting for the listener says nothing about the link
+        if (!*waited)
+            d->link.addRttSample(connectTimer.nsecsElapsed());
+        const int fd = std::exchange(*pendingFd, -1);
+        if (!d->socket.setSocketDescriptor(fd, QAbstractSocket::ConnectedState)) {
+            ::close(fd);
+            fail(QStringLiteral("Error: %1").arg(d->socket.errorString()));
+            return;
+        }
+        d->socketPath = host;
+        *holding = true;
+        d->acquireUpdates();
+    };
+
+    // A full backlog (EAGAIN on Linux) is retried; a connect in progress
+    // (EINPROGRESS elsewhere) completes when the socket turns writable
+    auto retry = new QTimer(connector);
+    retry->setInterval(10);
+    auto attempt = [host, addr, pendingFd, fail, adopt, waited, retry, connector]() {
+        if (*pendingFd < 0) // given up by cleanup
+            return;
+        if (::connect(*pendingFd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0 || errno == EISCONN) {
+            retry->stop();
+            adopt();
+            return;
+        }
+        const int error = errno;
+        *waited = true;
+        if (error == EAGAIN || error == EINTR) {
+            retry->start();
+            return;
+        }
+        retry->stop();
+        if (error != EINPROGRESS && error != EALREADY) {
+            fail(QStringLiteral("Error: cannot connect to %1: %2").arg(host, qt_error_string(error)));
+            return;
+        }
+        auto notifier = new QSocketNotifier(*pendingFd, QSocketNotifier::Write, connector);
+        QObject::connect(notifier, &QSocketNotifier::activated, connector, [host, pendingFd, fail, adopt, notifier]() {
+            notifier->setEnabled(false);
+            int result = 0;
+            socklen_t length = sizeof(result);
+            if (::getsockopt(*pendingFd, SOL_SOCKET, SO_ERROR, &result, &length) < 0)
+                result = errno;
+            if (result != 0)
+                fail(QStringLiteral("Error: cannot connect to %1: %2").arg(host, qt_error_string(result)));
+            else
+                adopt();
+        });
+    };
+    QObject::connect(retry, &QTimer::timeout, connector, attempt);
+    attempt();
+#endif
+    return call.track(promise->future());
+}
+
+bool Tools::disconnect()
+{
+    const auto call = d->stats.call("disconnect");
+    // Other clients attached to the same target keep it open
+    d->connectionSessions.remove(d->session);
+    if (!d->connectionSessions.isEmpty())
+        return false;
+    d->socket.disconnectFromHost();
+    return true;
+}
+
+QString Tools::setEncodings(const QString &encodings, int quality, int compression)
+{
+    const auto call = d->stats.call("setEncodings");
+    if (d->socket.state() != QTcpSocket::ConnectedState)
+        return QStringLiteral("Error: not connected");
+    const QString unknown = d->unknownClientEncodingsError();
+    if (!unknown.isEmpty())
+        return unknown;
+    QList<qint32> encodingList;
+    QString error;
+    const auto decodable = [this](qint32 encoding) { return d->clientDecodes(encoding); };
+    if (!parseEncodings(encodings, quality, compression, d->sessionReady ? decodable : std::function<bool(qint32)>(),
+                        &encodingList, &error))
+        return error;
+    d->encodings = encodingList;
+    d->sendEncodings();
+
+    // RFB has no acknowledgement: the server picks per rectangle from this
+    // list, so the effect shows up in getStats' transfer counters
+    QJsonObject obj = encodingsJson(encodingList);
+    obj[QStringLiteral("acknowledged")] = false;
+    return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+QString Tools::setReducedQuality(int quality)
+{
+    const auto call = d->stats.call("setReducedQuality");
+    // Lossy frames need Tight, so say so rather than never switching
+    if (quality >= 0 && d->sessionReady) {
+        const QString unknown = d->unknownClientEncodingsError();
+        if (!unknown.isEmpty())
+            return unknown;
+        if (!d->clientDecodes(7))
+            return QStringLiteral("Error: the VNC client cannot decode 'tight'");
+    }
+    const int previous = std::exchange(d->reducedQuality, qBound(-1, quality, 9));
+    // Re-send at the new level if lossy frames are already flowing
+    if (d->lossyActive && d->reducedQuality >= 0 && d->reducedQuality != previous)
+        d->lossyActive = false;
+    d->updateEncodingMode();
+    return QStringLiteral("true");
+}
+
+static QImage extractRegion(const QImage &image, int x, int y, int width, int height)
 {
     if (image.isNull())
         return {};
@@ -235,7 +1403,7 @@ static QList<QMcpCallToolResultContent> imageOrError(const QImage &image)
     return content;
 }
 
-static QImage compositeWithCursor(const QImage &framebuffer, const QVncClient *client, const QPointF &fallbackPos)
+static QImage compositeWithCursor(const QImage &framebuffer, const CursorState &cursor)
 {
     if (framebuffer.isNull())
         return framebuffer;
@@ -243,15 +1411,13 @@ static QImage compositeWithCursor(const QImage &framebuffer, const QVncClient *c
     QImage result = framebuffer.copy();
     QPainter painter(&result);
 
-    if (!client->cursorImage().isNull()) {
+    if (!cursor.image.isNull()) {
         // Server provided cursor shape via RichCursor pseudo-encoding
-        const QPoint pos = client->cursorPos();
-        const QPoint hotspot = client->cursorHotspot();
-        painter.drawImage(pos - hotspot, client->cursorImage());
+        painter.drawImage(cursor.pos - cursor.hotspot, cursor.image);
     } else {
         // Fallback: draw a simple arrow cursor at last known position
-        const int x = qRound(fallbackPos.x());
-        const int y = qRound(fallbackPos.y());
+        const int x = qRound(cursor.fallbackPos.x());
+        const int y = qRound(cursor.fallbackPos.y());
 
         static const QPointF arrowShape[] = {
             {0, 0}, {0, 12}, {3, 10}, {6, 15}, {8, 14}, {5, 9}, {9, 9}
@@ -273,48 +1439,104 @@ static QImage compositeWithCursor(const QImage &framebuffer, const QVncClient *c
     return result;
 }
 
-QFuture<QList<QMcpCallToolResultContent>> Tools::screenshot(int x, int y, int width, int height)
+QFuture<QList<QMcpCallToolResultContent>> Tools::screenshot(int x, int y, int width, int height, const QString &snapshot)
 {
-    if (d->vncClient.framebufferUpdatesEnabled() || d->socket.state() != QTcpSocket::ConnectedState) {
+    auto call = d->stats.call("screenshot");
+    if (!snapshot.isEmpty()) {
+        Snapshot *snap = d->snapshots.object(snapshot);
+        if (!snap)
+            return textResult(QStringLiteral("Error: unknown or expired snapshot '%1'").arg(snapshot));
+        if (snap->composited.isNull())
+            snap->composited = d->composite(snap->framebuffer, snap->cursor);
+        QPromise<QList<QMcpCallToolResultContent>> promise;
+        promise.start();
+        promise.addResult(d->imageResult(extractRegion(snap->composited, x, y, width, height)));
+        promise.finish();
+        return promise.future();
+    }
+
+    if (d->framebufferExact() || d->socket.state() != QTcpSocket::ConnectedState) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
-        QImage img = compositeWithCursor(d->vncClient.image(), &d->vncClient, d->pos);
-        promise.addResult(imageOrError(extractRegion(img, x, y, width, height)));
+        QImage img = d->composite(d->vncClient.image());
+        promise.addResult(d->imageResult(extractRegion(img, x, y, width, height)));
         promise.finish();
         return promise.future();
     }
 
     auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
     promise->start();
-    d->vncClient.setFramebufferUpdatesEnabled(true);
-    auto hasImageData = QSharedPointer<bool>::create(false);
-    auto connImg = QSharedPointer<QMetaObject::Connection>::create();
-    auto connFb = QSharedPointer<QMetaObject::Connection>::create();
-    // Track when real pixel data arrives (not just cursor pseudo-encoding)
-    *connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
-        [hasImageData](const QRect &) {
-            *hasImageData = true;
-        });
-    *connFb = QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this,
-        [this, promise, connImg, connFb, hasImageData, x, y, width, height]() {
-            if (!*hasImageData)
-                return; // cursor-only update, wait for real pixel data
-            QObject::disconnect(*connImg);
-            QObject::disconnect(*connFb);
-            d->updateFramebufferUpdates();
-            QImage img = compositeWithCursor(d->vncClient.image(), &d->vncClient, d->pos);
-            promise->addResult(imageOrError(extractRegion(img, x, y, width, height)));
+    d->refreshFor(promise, this, [this, promise, x, y, width, height]() {
+        QImage img = d->composite(d->vncClient.image());
+        promise->addResult(d->imageResult(extractRegion(img, x, y, width, height)));
+        promise->finish();
+    });
+    return call.track(promise->future());
+}
+
+QString Tools::setScreenshotStore(const QString &directory, const QString &format, bool hardLinks)
+{
+    const auto call = d->stats.call("setScreenshotStore");
+    if (directory.isEmpty()) {
+        d->screenshotStore.close();
+        return QStringLiteral("true");
+    }
+    if (!d->screenshotStore.open(directory, format.toLatin1(), hardLinks))
+        return QStringLiteral("Error: %1").arg(d->screenshotStore.errorString());
+    QJsonObject obj;
+    obj[QStringLiteral("directory")] = d->screenshotStore.directory();
+    obj[QStringLiteral("format")] = QString::fromLatin1(d->screenshotStore.format());
+    obj[QStringLiteral("hardLinks")] = d->screenshotStore.hardLinks();
+    obj[QStringLiteral("index")] = d->screenshotStore.directory() + QStringLiteral("/index.jsonl");
+    return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+// Hands the region to the store's I/O thread; the promise is fulfilled from
+// there once the object is written and indexed
+static void storeScreenshot(ScreenshotStore *store, const QImage &image, int x, int y, int width, int height,
+                            const QString &filePath, const QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>> &promise)
+{
+    const QImage region = extractRegion(image, x, y, width, height);
+    store->save(region, QRect(QPoint(x, y), region.size()), filePath)
+        .then(QtFuture::Launch::Sync, [promise](const ScreenshotStore::Result &result) {
+            QString text;
+            if (!result.error.isEmpty()) {
+                text = QStringLiteral("Error: %1").arg(result.error);
+            } else {
+                QJsonObject obj;
+                obj[QStringLiteral("hash")] = result.hash;
+                obj[QStringLiteral("object")] = result.objectPath;
+                obj[QStringLiteral("duplicate")] = result.duplicate;
+                if (!result.path.isEmpty())
+                    obj[QStringLiteral("path")] = result.path;
+                text = QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+            }
+            QList<QMcpCallToolResultContent> content;
+            content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
+            promise->addResult(content);
             promise->finish();
         });
-    return promise->future();
 }
 
 QFuture<QList<QMcpCallToolResultContent>> Tools::save(const QString &filePath, int x, int y, int width, int height)
 {
-    if (d->vncClient.framebufferUpdatesEnabled() || d->socket.state() != QTcpSocket::ConnectedState) {
+    auto call = d->stats.call("save");
+    if (d->screenshotStore.isOpen()) {
+        auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+        promise->start();
+        const auto store = [this, promise, filePath, x, y, width, height]() {
+            storeScreenshot(&d->screenshotStore, d->composite(d->vncClient.image()), x, y, width, height, filePath, promise);
+        };
+        if (d->framebufferExact() || d->socket.state() != QTcpSocket::ConnectedState)
+            store();
+        else
+            d->refreshFor(promise, this, store);
+        return call.track(promise->future());
+    }
+    if (d->framebufferExact() || d->socket.state() != QTcpSocket::ConnectedState) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
-        QImage img = compositeWithCursor(d->vncClient.image(), &d->vncClient, d->pos);
+        QImage img = d->composite(d->vncClient.image());
         bool ok = extractRegion(img, x, y, width, height).save(filePath);
         QList<QMcpCallToolResultContent> content;
         content.append(QMcpCallToolResultContent(QMcpTextContent(ok ? QStringLiteral("true") : QStringLiteral("false"))));
@@ -325,53 +1547,102 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::save(const QString &filePath, i
 
     auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
     promise->start();
-    d->vncClient.setFramebufferUpdatesEnabled(true);
-    auto hasImageData = QSharedPointer<bool>::create(false);
-    auto connImg = QSharedPointer<QMetaObject::Connection>::create();
-    auto connFb = QSharedPointer<QMetaObject::Connection>::create();
-    // Track when real pixel data arrives (not just cursor pseudo-encoding)
-    *connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
-        [hasImageData](const QRect &) {
-            *hasImageData = true;
-        });
-    *connFb = QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this,
-        [this, promise, connImg, connFb, hasImageData, filePath, x, y, width, height]() {
-            if (!*hasImageData)
-                return; // cursor-only update, wait for real pixel data
-            QObject::disconnect(*connImg);
-            QObject::disconnect(*connFb);
-            d->updateFramebufferUpdates();
-            QImage img = compositeWithCursor(d->vncClient.image(), &d->vncClient, d->pos);
-            bool ok = extractRegion(img, x, y, width, height).save(filePath);
-            QList<QMcpCallToolResultContent> content;
-            content.append(QMcpCallToolResultContent(QMcpTextContent(ok ? QStringLiteral("true") : QStringLiteral("false"))));
-            promise->addResult(content);
-            promise->finish();
-        });
-    return promise->future();
+    d->refreshFor(promise, this, [this, promise, filePath, x, y, width, height]() {
+        QImage img = d->composite(d->vncClient.image());
+        bool ok = extractRegion(img, x, y, width, height).save(filePath);
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(ok ? QStringLiteral("true") : QStringLiteral("false"))));
+        promise->addResult(content);
+        promise->finish();
+    });
+    return call.track(promise->future());
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::snapshot()
+{
+    auto call = d->stats.call("snapshot");
+    const auto takeSnapshot = [this]() {
+        const QImage &image = d->vncClient.image();
+        if (image.isNull())
+            return QStringLiteral("Error: no framebuffer available");
+        const QString handle = QStringLiteral("snapshot-%1").arg(++d->snapshotSerial);
+        if (!d->snapshots.insert(handle, new Snapshot { image, d->cursorState(), {} }, 2 * image.sizeInBytes()))
+            return QStringLiteral("Error: framebuffer exceeds the snapshot memory budget");
+        QJsonObject obj;
+        obj[QStringLiteral("snapshot")] = handle;
+        obj[QStringLiteral("width")] = image.width();
+        obj[QStringLiteral("height")] = image.height();
+        return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    };
+
+    if (d->framebufferExact() || d->socket.state() != QTcpSocket::ConnectedState)
+        return textResult(takeSnapshot());
+
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+    d->refreshFor(promise, this, [promise, takeSnapshot]() {
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(takeSnapshot())));
+        promise->addResult(content);
+        promise->finish();
+    });
+    return call.track(promise->future());
+}
+
+bool Tools::releaseSnapshot(const QString &snapshot)
+{
+    const auto call = d->stats.call("releaseSnapshot");
+    return d->snapshots.remove(snapshot);
+}
+
+QString Tools::getSharedFramebuffer()
+{
+    const auto call = d->stats.call("getSharedFramebuffer");
+    if (!d->sharedFramebuffer.isActive()) {
+        if (!d->sharedFramebuffer.publish(d->vncClient.image(), {})) {
+            const QString error = d->sharedFramebuffer.errorString();
+            return error.isEmpty() ? QStringLiteral("Error: no framebuffer available")
+                                   : QStringLiteral("Error: cannot create shared memory: %1").arg(error);
+        }
+        // Publishing follows every update, so updates stay on while shared
+        d->acquireUpdates();
+    }
+    return QString::fromUtf8(QJsonDocument(d->sharedFramebuffer.layout()).toJson(QJsonDocument::Compact));
+}
+
+bool Tools::stopSharedFramebuffer()
+{
+    const auto call = d->stats.call("stopSharedFramebuffer");
+    if (!d->sharedFramebuffer.isActive())
+        return false;
+    d->sharedFramebuffer.stop();
+    d->sharedDamage.clear();
+    d->releaseUpdates();
+    return true;
 }
 
 QString Tools::status() const
 {
+    const auto call = d->stats.call("status");
     if (d->socket.state() == QTcpSocket::ConnectedState) {
         const int w = d->vncClient.framebufferWidth();
         const int h = d->vncClient.framebufferHeight();
         if (w > 0 && h > 0) {
-            return QStringLiteral("connected to %1:%2 (%3x%4)")
-                .arg(d->socket.peerName())
-                .arg(d->socket.peerPort())
+            return QStringLiteral("connected to %1 (%2x%3); %4")
+                .arg(d->target())
                 .arg(w)
-                .arg(h);
+                .arg(h)
+                .arg(d->link.summary());
         }
-        return QStringLiteral("connecting to %1:%2 (VNC handshake in progress)")
-            .arg(d->socket.peerName())
-            .arg(d->socket.peerPort());
+        return QStringLiteral("connecting to %1 (VNC handshake in progress)")
+            .arg(d->target());
     }
     return QStringLiteral("disconnected");
 }
 
 QString Tools::getCursorInfo() const
 {
+    const auto call = d->stats.call("getCursorInfo");
     const QPoint pos = d->vncClient.cursorPos();
     const QPoint hotspot = d->vncClient.cursorHotspot();
     const QImage cursor = d->vncClient.cursorImage();
@@ -381,8 +1652,81 @@ QString Tools::getCursorInfo() const
         .arg(cursor.width()).arg(cursor.height());
 }
 
+QJsonObject Tools::collectStats() const
+{
+    QJsonObject memory;
+    memory[QStringLiteral("framebufferBytes")] = qint64(d->vncClient.image().sizeInBytes());
+    memory[QStringLiteral("cursorBytes")] = qint64(d->vncClient.cursorImage().sizeInBytes());
+    memory[QStringLiteral("clipboardBytes")] = qint64(d->lastClipboardText.size() * sizeof(QChar)
+                                                      + d->lastClipboardImage.sizeInBytes());
+    memory[QStringLiteral("snapshots")] = qint64(d->snapshots.count());
+    memory[QStringLiteral("snapshotBytes")] = qint64(d->snapshots.totalCost());
+
+    QJsonObject obj = d->stats.toJson();
+    obj[QStringLiteral("memory")] = memory;
+    obj[QStringLiteral("link")] = d->link.toJson();
+    // What keeps framebuffer updates flowing; all zero once tools are idle
+    QJsonObject updates;
+    updates[QStringLiteral("enabled")] = d->vncClient.framebufferUpdatesEnabled();
+    updates[QStringLiteral("holds")] = d->updateHolds;
+    updates[QStringLiteral("regionsOfInterest")] = d->regionsOfInterest.size();
+    updates[QStringLiteral("refreshWaiters")] = d->refreshWaiters.size();
+    obj[QStringLiteral("updates")] = updates;
+    if (!d->socket.clientEncodings().isEmpty())
+        obj[QStringLiteral("clientEncodings")] = encodingsJson(d->socket.clientEncodings())[QStringLiteral("encodings")];
+    if (!d->encodings.isEmpty())
+        obj[QStringLiteral("requestedEncodings")] = encodingsJson(d->encodings);
+    if (d->reducedQuality >= 0) {
+        QJsonObject reduced;
+        reduced[QStringLiteral("quality")] = d->reducedQuality;
+        reduced[QStringLiteral("active")] = d->lossyActive;
+        obj[QStringLiteral("reducedQuality")] = reduced;
+    }
+    return obj;
+}
+
+QString Tools::getStats() const
+{
+    const auto call = d->stats.call("getStats");
+    return QString::fromUtf8(QJsonDocument(collectStats()).toJson(QJsonDocument::Compact));
+}
+
+void Tools::setStatsInterval(int interval)
+{
+    const auto call = d->stats.call("setStatsInterval");
+    const QUuid session = d->session;
+    delete d->statsTimers.take(session);
+    if (interval <= 0)
+        return;
+    auto *timer = new QTimer(this);
+    QObject::connect(timer, &QTimer::timeout, this, [this, session]() {
+        emit statsReported(session, collectStats());
+    });
+    timer->start(qMax(1000, interval));
+    d->statsTimers.insert(session, timer);
+}
+
+bool Tools::startTrace(const QString &filePath)
+{
+    const auto call = d->stats.call("startTrace");
+    return Tracer::instance()->start(filePath);
+}
+
+QString Tools::stopTrace()
+{
+    const auto call = d->stats.call("stopTrace");
+    auto *tracer = Tracer::instance();
+    if (!tracer->isEnabled())
+        return QStringLiteral("Error: no trace in progress");
+    const qsizetype events = tracer->eventCount();
+    if (!tracer->stop())
+        return QStringLiteral("Error: cannot write %1").arg(tracer->filePath());
+    return QStringLiteral("Wrote %1 trace events to %2").arg(events).arg(tracer->filePath());
+}
+
 void Tools::mouseMove(int x, int y, int button)
 {
+    const auto call = d->stats.call("mouseMove");
     Qt::MouseButton qtButton = Qt::NoButton;
     if (button == 1)
         qtButton = Qt::LeftButton;
@@ -395,10 +1739,12 @@ void Tools::mouseMove(int x, int y, int button)
 
     QMouseEvent event(QEvent::MouseMove, d->pos, d->pos, Qt::NoButton, qtButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&event);
+    d->inputSent();
 }
 
 void Tools::mouseClick(int x, int y, int button)
 {
+    const auto call = d->stats.call("mouseClick");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -414,10 +1760,12 @@ void Tools::mouseClick(int x, int y, int button)
     // Release
     QMouseEvent releaseEvent(QEvent::MouseButtonRelease, d->pos, d->pos, Qt::NoButton, Qt::NoButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&releaseEvent);
+    d->inputSent();
 }
 
 void Tools::doubleClick(int x, int y, int button)
 {
+    const auto call = d->stats.call("doubleClick");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -439,10 +1787,12 @@ void Tools::doubleClick(int x, int y, int button)
 
     QMouseEvent releaseEvent2(QEvent::MouseButtonRelease, d->pos, d->pos, qtButton, Qt::NoButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&releaseEvent2);
+    d->inputSent();
 }
 
 void Tools::mousePress(int x, int y, int button)
 {
+    const auto call = d->stats.call("mousePress");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -453,10 +1803,12 @@ void Tools::mousePress(int x, int y, int button)
 
     QMouseEvent pressEvent(QEvent::MouseButtonPress, d->pos, d->pos, qtButton, qtButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&pressEvent);
+    d->inputSent();
 }
 
 void Tools::mouseRelease(int x, int y, int button)
 {
+    const auto call = d->stats.call("mouseRelease");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -467,10 +1819,12 @@ void Tools::mouseRelease(int x, int y, int button)
 
     QMouseEvent releaseEvent(QEvent::MouseButtonRelease, d->pos, d->pos, qtButton, Qt::NoButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&releaseEvent);
+    d->inputSent();
 }
 
 void Tools::longPress(int x, int y, int duration, int button)
 {
+    const auto call = d->stats.call("longPress");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -482,14 +1836,18 @@ void Tools::longPress(int x, int y, int duration, int button)
     QMouseEvent pressEvent(QEvent::MouseButtonPress, d->pos, d->pos, qtButton, qtButton, Qt::NoModifier);
     d->vncClient.handlePointerEvent(&pressEvent);
 
+    d->inputSent();
+
     QTimer::singleShot(duration, this, [this, qtButton]() {
         QMouseEvent releaseEvent(QEvent::MouseButtonRelease, d->pos, d->pos, qtButton, Qt::NoButton, Qt::NoModifier);
         d->vncClient.handlePointerEvent(&releaseEvent);
+        d->inputSent();
     });
 }
 
 QFuture<QList<QMcpCallToolResultContent>> Tools::dragAndDrop(int x, int y, int button)
 {
+    auto call = d->stats.call("dragAndDrop");
     Qt::MouseButton qtButton = Qt::LeftButton;
     if (button == 2)
         qtButton = Qt::MiddleButton;
@@ -505,31 +1863,51 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::dragAndDrop(int x, int y, int b
     auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
     promise->start();
 
-    // Delay between press and move so the remote app can enter drag mode
-    QTimer::singleShot(100, this, [this, promise, endPos, qtButton]() {
-        // Move to end position with button held
-        QMouseEvent moveEvent(QEvent::MouseMove, endPos, endPos, Qt::NoButton, qtButton, Qt::NoModifier);
-        d->vncClient.handlePointerEvent(&moveEvent);
+    // Delay between press and move so the remote app can enter drag mode,
+    // and between move and release
+    auto timer = new QTimer(this);
+    timer->setSingleShot(true);
+    auto moved = QSharedPointer<bool>::create(false);
+    const QPointF startPos = d->pos;
 
-        // Delay between move and release
-        QTimer::singleShot(50, this, [this, promise, endPos, qtButton]() {
-            // Release at end position
-            QMouseEvent releaseEvent(QEvent::MouseButtonRelease, endPos, endPos, qtButton, Qt::NoButton, Qt::NoModifier);
-            d->vncClient.handlePointerEvent(&releaseEvent);
+    // Also ends a canceled drag, so the button is never left held
+    const auto release = [this, timer, moved, startPos, endPos, qtButton]() {
+        timer->stop();
+        timer->deleteLater();
+        const QPointF pos = *moved ? endPos : startPos;
+        QMouseEvent releaseEvent(QEvent::MouseButtonRelease, pos, pos, qtButton, Qt::NoButton, Qt::NoModifier);
+        d->vncClient.handlePointerEvent(&releaseEvent);
 
-            d->pos = endPos;
+        d->pos = pos;
+        d->inputSent();
+    };
 
-            QList<QMcpCallToolResultContent> content;
-            promise->addResult(content);
-            promise->finish();
-        });
+    QObject::connect(timer, &QTimer::timeout, this, [this, promise, timer, moved, endPos, qtButton, release]() {
+        if (!*moved) {
+            // Move to end position with button held
+            QMouseEvent moveEvent(QEvent::MouseMove, endPos, endPos, Qt::NoButton, qtButton, Qt::NoModifier);
+            d->vncClient.handlePointerEvent(&moveEvent);
+            *moved = true;
+            timer->start(50);
+            return;
+        }
+        release();
+        QList<QMcpCallToolResultContent> content;
+        promise->addResult(content);
+        promise->finish();
     });
+    d->onCanceled(promise->future(), this, [promise, release]() {
+        release();
+        promise->finish();
+    });
+    timer->start(100);
 
-    return promise->future();
+    return call.track(promise->future());
 }
 
 void Tools::sendKey(int keysym, bool down)
 {
+    const auto call = d->stats.call("sendKey");
     if (d->socket.state() != QTcpSocket::ConnectedState)
         return;
     const quint8 messageType = 0x04;
@@ -540,6 +1918,7 @@ void Tools::sendKey(int keysym, bool down)
     d->socket.write(reinterpret_cast<const char *>(&downFlag), 1);
     d->socket.write(reinterpret_cast<const char *>(padding), 2);
     d->socket.write(reinterpret_cast<const char *>(&key), 4);
+    d->inputSent();
 }
 
 void Tools::sendKey(const QString &keysym, bool down)
@@ -552,6 +1931,7 @@ void Tools::sendKey(const QString &keysym, bool down)
 
 void Tools::sendText(const QString &text)
 {
+    const auto call = d->stats.call("sendText");
     for (const QChar &ch : text) {
         int keysym = ch.unicode();
         QKeyEvent pressEvent(QEvent::KeyPress, 0, Qt::NoModifier, QString(ch));
@@ -559,41 +1939,97 @@ void Tools::sendText(const QString &text)
         QKeyEvent releaseEvent(QEvent::KeyRelease, 0, Qt::NoModifier, QString(ch));
         d->vncClient.handleKeyEvent(&releaseEvent);
     }
+    d->inputSent();
+}
+
+void Tools::setInputBurst(int window)
+{
+    const auto call = d->stats.call("setInputBurst");
+    d->inputBurstWindow = qMax(-1, window);
+    if (d->inputBurstWindow == 0 && d->inputBurstTimer.isActive()) {
+        d->inputBurstTimer.stop();
+        d->updateFramebufferUpdates();
+    }
+}
+
+void Tools::setUpdatePipelining(int depth)
+{
+    const auto call = d->stats.call("setUpdatePipelining");
+    d->pipelineDepth = qBound(-1, depth, 4);
+    d->pipelineRequests();
 }
 
 void Tools::setPreview(bool visible)
 {
+    const auto call = d->stats.call("setPreview");
+    // The preview keeps updates flowing even where no window can be shown
+    // (headless), so the live framebuffer it implies is there either way
     d->previewEnabled = visible;
     d->updateFramebufferUpdates();
+#ifdef HAVE_WIDGETS
+    if (visible)
+        d->createPreviewWidget();
     if (!d->previewWidget)
         return;
     if (visible && d->socket.state() == QTcpSocket::ConnectedState)
         d->previewWidget->show();
     else
         d->previewWidget->hide();
+#endif
 }
 
 void Tools::setInteractive(bool enabled)
 {
+    const auto call = d->stats.call("setInteractive");
+    d->previewInteractive = enabled;
+#ifdef HAVE_WIDGETS
     if (d->previewWidget)
         d->previewWidget->setInteractive(enabled);
+#endif
 }
 
 void Tools::setStaysOnTop(bool enabled)
 {
+    const auto call = d->stats.call("setStaysOnTop");
+    d->previewStaysOnTop = enabled;
+#ifdef HAVE_WIDGETS
     if (!d->previewWidget)
         return;
     const bool wasVisible = d->previewWidget->isVisible();
     d->previewWidget->setWindowFlag(Qt::WindowStaysOnTopHint, enabled);
     if (wasVisible)
         d->previewWidget->show();
+#endif
+}
+
+void Tools::setPreviewFrameRate(int fps)
+{
+    const auto call = d->stats.call("setPreviewFrameRate");
+    d->previewFrameRate = qMax(0, fps);
+#ifdef HAVE_WIDGETS
+    if (d->previewWidget)
+        d->previewWidget->setMaximumFrameRate(fps);
+#endif
+}
+
+void Tools::setPreviewScaled(bool enabled)
+{
+    const auto call = d->stats.call("setPreviewScaled");
+    d->previewScaled = enabled;
+#ifdef HAVE_WIDGETS
+    if (d->previewWidget)
+        d->previewWidget->setScaledToFit(enabled);
+#endif
 }
 
 void Tools::setPreviewTitle(const QString &title)
 {
-    if (!d->previewWidget)
-        return;
-    d->previewWidget->setWindowTitle(title);
+    const auto call = d->stats.call("setPreviewTitle");
+    d->previewTitle = title;
+#ifdef HAVE_WIDGETS
+    if (d->previewWidget)
+        d->previewWidget->setWindowTitle(title);
+#endif
 }
 
 // --- Macro tools ---
@@ -613,12 +2049,14 @@ static const QStringList validActions = {
 
 void Tools::setMacroDir(const QString &path)
 {
+    const auto call = d->stats.call("setMacroDir");
     d->macroDir = path;
     QDir().mkpath(path);
 }
 
 bool Tools::createMacro(const QString &name, const QString &description)
 {
+    const auto call = d->stats.call("createMacro");
     if (d->macroDir.isEmpty())
         return false;
 
@@ -640,6 +2078,7 @@ bool Tools::createMacro(const QString &name, const QString &description)
 
 bool Tools::addMacroStep(const QString &name, const QString &action, const QString &params, int delay)
 {
+    const auto call = d->stats.call("addMacroStep");
     if (d->macroDir.isEmpty())
         return false;
     if (!validActions.contains(action))
@@ -680,6 +2119,8 @@ bool Tools::addMacroStep(const QString &name, const QString &action, const QStri
 
 void Tools::executeStep(const QString &action, const QJsonObject &params, std::function<void()> onCompleted)
 {
+    // Steps are part of the playMacro or actAndCapture call that runs them
+    const Stats::Internal internal(d->stats);
     if (action == QLatin1String("mouseMove")) {
         mouseMove(params[QStringLiteral("x")].toInt(), params[QStringLiteral("y")].toInt(),
                   params[QStringLiteral("button")].toInt(0));
@@ -720,6 +2161,7 @@ void Tools::executeStep(const QString &action, const QJsonObject &params, std::f
             params[QStringLiteral("y")].toInt(),
             params[QStringLiteral("color")].toString(),
             params[QStringLiteral("timeout")].toInt(30000));
+        d->macroStepFuture = future;
         future.then(this, [onCompleted](const QList<QMcpCallToolResultContent> &) {
             onCompleted();
         });
@@ -730,6 +2172,7 @@ void Tools::executeStep(const QString &action, const QJsonObject &params, std::f
 
 QFuture<QList<QMcpCallToolResultContent>> Tools::playMacro(const QString &name, int speedFactor)
 {
+    auto call = d->stats.call("playMacro");
     if (d->macroDir.isEmpty() || d->macroPlaying) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
@@ -784,11 +2227,28 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::playMacro(const QString &name,
 
     auto stepsPtr = QSharedPointer<QJsonArray>::create(steps);
     auto indexPtr = QSharedPointer<int>::create(0);
+    auto canceled = QSharedPointer<bool>::create(false);
     auto factor = qMax(1, speedFactor);
 
+    d->cancelMacro = [this, promise, stepsPtr, indexPtr, canceled]() {
+        *canceled = true;
+        d->macroStepFuture.cancel();
+        d->macroPlaying = false;
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QStringLiteral("Macro canceled: %1 of %2 steps executed").arg(*indexPtr).arg(stepsPtr->size()))));
+        promise->addResult(content);
+        promise->finish();
+    };
+    d->onCanceled(promise->future(), this, [this]() {
+        d->stopMacro();
+    });
+
     // Use a recursive lambda via std::function to chain steps with QTimer::singleShot
     auto executeNext = QSharedPointer<std::function<void()>>::create();
-    *executeNext = [this, promise, stepsPtr, indexPtr, factor, executeNext]() {
+    *executeNext = [this, promise, stepsPtr, indexPtr, canceled, factor, executeNext]() {
+        if (*canceled)
+            return;
         if (*indexPtr >= stepsPtr->size()) {
             QList<QMcpCallToolResultContent> content;
             content.append(QMcpCallToolResultContent(QMcpTextContent(
@@ -796,6 +2256,7 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::playMacro(const QString &name,
             promise->addResult(content);
             promise->finish();
             d->macroPlaying = false;
+            d->cancelMacro = nullptr;
             return;
         }
 
@@ -805,7 +2266,9 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::playMacro(const QString &name,
         QJsonObject params = step[QStringLiteral("params")].toObject();
         (*indexPtr)++;
 
-        QTimer::singleShot(delay, this, [this, action, params, executeNext]() {
+        QTimer::singleShot(delay, this, [this, action, params, canceled, executeNext]() {
+            if (*canceled)
+                return;
             executeStep(action, params, [this, executeNext]() {
                 // Yield to event loop before next step (even with delay=0)
                 QTimer::singleShot(0, this, [executeNext]() {
@@ -818,11 +2281,18 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::playMacro(const QString &name,
     // Kick off the first step
     (*executeNext)();
 
-    return promise->future();
+    return call.track(promise->future());
+}
+
+bool Tools::cancelMacro()
+{
+    const auto call = d->stats.call("cancelMacro");
+    return d->stopMacro();
 }
 
 QStringList Tools::listMacros()
 {
+    const auto call = d->stats.call("listMacros");
     if (d->macroDir.isEmpty())
         return {};
 
@@ -836,6 +2306,7 @@ QStringList Tools::listMacros()
 
 QString Tools::getMacro(const QString &name)
 {
+    const auto call = d->stats.call("getMacro");
     if (d->macroDir.isEmpty())
         return {};
 
@@ -848,6 +2319,7 @@ QString Tools::getMacro(const QString &name)
 
 bool Tools::deleteMacro(const QString &name)
 {
+    const auto call = d->stats.call("deleteMacro");
     if (d->macroDir.isEmpty())
         return false;
 
@@ -904,8 +2376,9 @@ static QList<QMcpCallToolResultContent> checkPixelColorResult(const QImage &imag
     return content;
 }
 
-QFuture<QList<QMcpCallToolResultContent>> Tools::checkPixelColor(int x, int y, const QString &color, qreal similarity)
+QFuture<QList<QMcpCallToolResultContent>> Tools::checkPixelColor(int x, int y, const QString &color, qreal similarity, const QString &snapshot)
 {
+    auto call = d->stats.call("checkPixelColor");
     const QColor targetColor(color);
     if (!targetColor.isValid()) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
@@ -918,7 +2391,18 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::checkPixelColor(int x, int y, c
         return promise.future();
     }
 
-    if (d->vncClient.framebufferUpdatesEnabled() || d->socket.state() != QTcpSocket::ConnectedState) {
+    if (!snapshot.isEmpty()) {
+        const Snapshot *snap = d->snapshots.object(snapshot);
+        if (!snap)
+            return textResult(QStringLiteral("Error: unknown or expired snapshot '%1'").arg(snapshot));
+        QPromise<QList<QMcpCallToolResultContent>> promise;
+        promise.start();
+        promise.addResult(checkPixelColorResult(snap->framebuffer, x, y, targetColor, similarity));
+        promise.finish();
+        return promise.future();
+    }
+
+    if (d->framebufferExact() || d->socket.state() != QTcpSocket::ConnectedState) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
         promise.addResult(checkPixelColorResult(d->vncClient.image(), x, y, targetColor, similarity));
@@ -928,29 +2412,16 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::checkPixelColor(int x, int y, c
 
     auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
     promise->start();
-    d->vncClient.setFramebufferUpdatesEnabled(true);
-    auto hasImageData = QSharedPointer<bool>::create(false);
-    auto connImg = QSharedPointer<QMetaObject::Connection>::create();
-    auto connFb = QSharedPointer<QMetaObject::Connection>::create();
-    *connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
-        [hasImageData](const QRect &) {
-            *hasImageData = true;
-        });
-    *connFb = QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this,
-        [this, promise, connImg, connFb, hasImageData, x, y, targetColor, similarity]() {
-            if (!*hasImageData)
-                return;
-            QObject::disconnect(*connImg);
-            QObject::disconnect(*connFb);
-            d->updateFramebufferUpdates();
-            promise->addResult(checkPixelColorResult(d->vncClient.image(), x, y, targetColor, similarity));
-            promise->finish();
-        });
-    return promise->future();
+    d->refreshFor(promise, this, [this, promise, x, y, targetColor, similarity]() {
+        promise->addResult(checkPixelColorResult(d->vncClient.image(), x, y, targetColor, similarity));
+        promise->finish();
+    });
+    return call.track(promise->future());
 }
 
 QFuture<QList<QMcpCallToolResultContent>> Tools::waitForColor(int x, int y, const QString &color, int timeout, qreal similarity)
 {
+    auto call = d->stats.call("waitForColor");
     const QColor targetColor(color);
 
     if (!targetColor.isValid()) {
@@ -977,34 +2448,75 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::waitForColor(int x, int y, cons
     auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
     promise->start();
 
-    d->vncClient.setFramebufferUpdatesEnabled(true);
+    // Only the watched pixel needs updates unless something else wants more
+    const QRect region(x, y, 1, 1);
+    const quint64 startSerial = d->updateSerial;
+    const bool wasLive = d->framebufferLive();
+    d->acquireRegion(region);
 
     auto pollTimer = new QTimer(this);
     auto timeoutTimer = new QTimer(this);
-    pollTimer->setInterval(1000);
+    pollTimer->setInterval(d->link.pollInterval());
     timeoutTimer->setSingleShot(true);
     timeoutTimer->setInterval(timeout);
 
-    auto cleanup = [this, pollTimer, timeoutTimer]() {
+    // The refresh a match is waiting on, if any; cancel leaves it
+    auto refreshWaiter = QSharedPointer<quint64>::create(0);
+    auto cleanedUp = QSharedPointer<bool>::create(false);
+
+    auto cleanup = [this, pollTimer, timeoutTimer, region, cleanedUp]() {
+        if (std::exchange(*cleanedUp, true))
+            return;
         pollTimer->stop();
         timeoutTimer->stop();
         pollTimer->deleteLater();
         timeoutTimer->deleteLater();
-        d->updateFramebufferUpdates();
+        d->releaseRegion(region);
     };
 
-    QObject::connect(pollTimer, &QTimer::timeout, this, [this, promise, cleanup, x, y, targetColor, similarity]() {
+    QObject::connect(pollTimer, &QTimer::timeout, this, [this, promise, cleanup, pollTimer, refreshWaiter, x, y, targetColor, similarity, startSerial, wasLive]() {
         const QImage &image = d->vncClient.image();
         if (image.isNull())
             return;
         if (x < 0 || x >= image.width() || y < 0 || y >= image.height())
             return;
-        if (colorMatches(QColor(image.pixel(x, y)), targetColor, similarity)) {
+        // The pixel may predate the wait until the first update lands
+        if (!wasLive && d->updateSerial == startSerial)
+            return;
+        if (!d->lossyActive && !d->lossyPixels) {
+            if (!colorMatches(QColor(image.pixel(x, y)), targetColor, similarity))
+                return;
             cleanup();
-            QImage img = compositeWithCursor(image, &d->vncClient, d->pos);
-            promise->addResult(imageOrError(img));
-            promise->finish();
+            if (d->framebufferExact()) {
+                promise->addResult(d->imageResult(d->composite(image)));
+                promise->finish();
+                return;
+            }
+            // Only the watched region was kept current
+            *refreshWaiter = d->refresh([this, promise]() {
+                promise->addResult(d->imageResult(d->composite(d->vncClient.image())));
+                promise->finish();
+            });
+            return;
         }
+        // JPEG shifts colors slightly: a near match on a lossy frame is only
+        // a candidate, confirmed on a lossless refresh
+        if (!colorMatches(QColor(image.pixel(x, y)), targetColor, qMin(similarity, 0.85)))
+            return;
+        pollTimer->stop();
+        *refreshWaiter = d->refresh([this, promise, cleanup, pollTimer, x, y, targetColor, similarity]() {
+            if (promise->future().isFinished())
+                return;
+            const QImage &image = d->vncClient.image();
+            if (x < image.width() && y < image.height()
+                && colorMatches(QColor(image.pixel(x, y)), targetColor, similarity)) {
+                cleanup();
+                promise->addResult(d->imageResult(d->composite(image)));
+                promise->finish();
+                return;
+            }
+            pollTimer->start();
+        });
     });
 
     QObject::connect(timeoutTimer, &QTimer::timeout, this, [this, promise, cleanup, x, y, color, timeout]() {
@@ -1022,19 +2534,272 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::waitForColor(int x, int y, cons
         promise->finish();
     });
 
+    d->onCanceled(promise->future(), this, [this, promise, cleanup, refreshWaiter]() {
+        d->leaveRefresh(*refreshWaiter);
+        cleanup();
+        promise->finish();
+    });
+
     pollTimer->start();
     timeoutTimer->start();
 
-    return promise->future();
+    return call.track(promise->future());
+}
+
+QString Tools::watchRegion(int x, int y, int width, int height, const QString &condition, const QString &color, const QString &templatePath, qreal similarity, bool once)
+{
+    const auto call = d->stats.call("watchRegion");
+    if (d->socket.state() != QTcpSocket::ConnectedState)
+        return QStringLiteral("Error: not connected");
+
+    RegionWatch watch;
+    watch.session = d->session;
+    watch.similarity = similarity;
+    watch.once = once;
+    if (condition == QLatin1String("change")) {
+        watch.condition = RegionWatch::Change;
+    } else if (condition == QLatin1String("color")) {
+        watch.condition = RegionWatch::Color;
+        watch.color = QColor(color);
+        if (!watch.color.isValid())
+            return QStringLiteral("Error: invalid color format '%1'. Use hex format like \"#FF0000\".").arg(color);
+        // A single pixel unless a region is given
+        if (width < 0)
+            width = 1;
+        if (height < 0)
+            height = 1;
+    } else if (condition == QLatin1String("image")) {
+        watch.condition = RegionWatch::Image;
+        watch.image = QImage(templatePath).convertToFormat(QImage::Format_RGB32);
+        if (watch.image.isNull())
+            return QStringLiteral("Error: cannot load template image '%1'").arg(templatePath);
+        // The template's size is the region's unless one is given
+        if (width < 0)
+            width = watch.image.width();
+        if (height < 0)
+            height = watch.image.height();
+    } else {
+        return QStringLiteral("Error: unknown condition '%1'; use change, color or image").arg(condition);
+    }
+
+    const QSize size(d->vncClient.framebufferWidth(), d->vncClient.framebufferHeight());
+    if (width < 0)
+        width = size.width() - x;
+    if (height < 0)
+        height = size.height() - y;
+    watch.rect = QRect(x, y, width, height) & QRect(QPoint(0, 0), size);
+    if (watch.rect.isEmpty())
+        return QStringLiteral("Error: region is outside the framebuffer");
+    // Compared pixel for pixel, so a cropped or padded template could never match
+    if (watch.condition == RegionWatch::Image && watch.image.size() != watch.rect.size()) {
+        return QStringLiteral("Error: template is %1x%2 but the region is %3x%4")
+            .arg(watch.image.width()).arg(watch.image.height()).arg(watch.rect.width()).arg(watch.rect.height());
+    }
+
+    const QString handle = QStringLiteral("watch-%1").arg(++d->watchSerial);
+    watch.startSerial = d->updateSerial;
+    d->watches.insert(handle, watch);
+    d->acquireRegion(watch.rect);
+    d->updateEncodingMode();
+
+    QJsonObject obj;
+    obj[QStringLiteral("watch")] = handle;
+    obj[QStringLiteral("x")] = watch.rect.x();
+    obj[QStringLiteral("y")] = watch.rect.y();
+    obj[QStringLiteral("width")] = watch.rect.width();
+    obj[QStringLiteral("height")] = watch.rect.height();
+    return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+bool Tools::unwatchRegion(const QString &watch)
+{
+    const auto call = d->stats.call("unwatchRegion");
+    const auto it = d->watches.find(watch);
+    if (it == d->watches.end() || it->session != d->session)
+        return false;
+    const QRect rect = it->rect;
+    d->watches.erase(it);
+    d->releaseRegion(rect);
+    return true;
+}
+
+// True when every pixel in rect matches color. UI regions are mostly flat,
+// so a run of equal pixels is only compared once.
+static bool regionIsColor(const QImage &image, const QRect &rect, const QColor &color, qreal similarity)
+{
+    QRgb last = 0;
+    bool lastMatches = false;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            const QRgb pixel = image.pixel(x, y);
+            if (pixel != last || (x == rect.left() && y == rect.top())) {
+                last = pixel;
+                lastMatches = colorMatches(QColor(pixel), color, similarity);
+            }
+            if (!lastMatches)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Mean per-channel difference of two equally sized RGB32 images, 0-1
+static qreal imageDifference(const QImage &a, const QImage &b)
+{
+    quint64 total = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const QRgb *rowA = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const QRgb *rowB = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x) {
+            total += qAbs(qRed(rowA[x]) - qRed(rowB[x])) + qAbs(qGreen(rowA[x]) - qGreen(rowB[x]))
+                + qAbs(qBlue(rowA[x]) - qBlue(rowB[x]));
+        }
+    }
+    return qreal(total) / (qreal(a.width()) * a.height() * 3 * 255);
+}
+
+void Tools::evaluateWatches()
+{
+    const QRegion damage = std::exchange(d->watchDamage, QRegion());
+    const QImage &image = d->vncClient.image();
+    QStringList finished;
+    for (auto it = d->watches.begin(); it != d->watches.end(); ++it) {
+        RegionWatch &watch = *it;
+        if (d->updateSerial <= watch.startSerial)
+            continue;
+        if (watch.primed && !damage.intersects(watch.rect))
+            continue;
+        if (!image.rect().contains(watch.rect))
+            continue;
+
+        bool fire = false;
+        if (watch.condition == RegionWatch::Change) {
+            const size_t hash = regionHash(image, watch.rect);
+            fire = watch.primed && hash != watch.hash;
+            watch.hash = hash;
+        } else {
+            bool met;
+            if (watch.condition == RegionWatch::Color)
+                met = regionIsColor(image, watch.rect, watch.color, watch.similarity);
+            else
+                met = imageDifference(image.copy(watch.rect).convertToFormat(QImage::Format_RGB32), watch.image) <= 1.0 - watch.similarity;
+            // Fires when the condition becomes true, including at the start
+            fire = met && !watch.met;
+            watch.met = met;
+        }
+        watch.primed = true;
+        if (!fire)
+            continue;
+
+        static const char *conditionNames[] = { "change", "color", "image" };
+        QJsonObject event;
+        event[QStringLiteral("watch")] = it.key();
+        event[QStringLiteral("condition")] = QLatin1String(conditionNames[watch.condition]);
+        event[QStringLiteral("x")] = watch.rect.x();
+        event[QStringLiteral("y")] = watch.rect.y();
+        event[QStringLiteral("width")] = watch.rect.width();
+        event[QStringLiteral("height")] = watch.rect.height();
+        if (watch.condition == RegionWatch::Change) {
+            const QRect changed = (damage & watch.rect).boundingRect();
+            QJsonObject changedRect;
+            changedRect[QStringLiteral("x")] = changed.x();
+            changedRect[QStringLiteral("y")] = changed.y();
+            changedRect[QStringLiteral("width")] = changed.width();
+            changedRect[QStringLiteral("height")] = changed.height();
+            event[QStringLiteral("changed")] = changedRect;
+        }
+        event[QStringLiteral("once")] = watch.once;
+        emit regionWatchTriggered(watch.session, event);
+        if (watch.once)
+            finished.append(it.key());
+    }
+    for (const QString &handle : std::as_const(finished))
+        d->releaseRegion(d->watches.take(handle).rect);
+}
+
+// Clipboard payloads go inline up to the inline limit, or straight to
+// filePath with only the path and metadata returned
+static QList<QMcpCallToolResultContent> clipboardTextResult(const QString &text, const QString &filePath, qint64 inlineLimit)
+{
+    QList<QMcpCallToolResultContent> content;
+    const QByteArray utf8 = text.toUtf8();
+    if (filePath.isEmpty()) {
+        if (utf8.size() > inlineLimit) {
+            content.append(QMcpCallToolResultContent(QMcpTextContent(
+                QStringLiteral("Error: clipboard text is %1 bytes, above the %2 byte inline limit; pass filePath to save it")
+                    .arg(utf8.size()).arg(inlineLimit))));
+        } else {
+            content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
+        }
+        return content;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(utf8) != utf8.size()) {
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QStringLiteral("Error: cannot write %1: %2").arg(filePath, file.errorString()))));
+        return content;
+    }
+    QJsonObject obj;
+    obj[QStringLiteral("filePath")] = filePath;
+    obj[QStringLiteral("bytes")] = qint64(utf8.size());
+    obj[QStringLiteral("characters")] = qint64(text.size());
+    content.append(QMcpCallToolResultContent(QMcpTextContent(
+        QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)))));
+    return content;
+}
+
+static QList<QMcpCallToolResultContent> clipboardImageResult(const QImage &image, const QString &filePath)
+{
+    QList<QMcpCallToolResultContent> content;
+    if (!image.save(filePath)) {
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QStringLiteral("Error: cannot write %1").arg(filePath))));
+        return content;
+    }
+    QJsonObject obj;
+    obj[QStringLiteral("filePath")] = filePath;
+    obj[QStringLiteral("bytes")] = QFileInfo(filePath).size();
+    obj[QStringLiteral("width")] = image.width();
+    obj[QStringLiteral("height")] = image.height();
+    content.append(QMcpCallToolResultContent(QMcpTextContent(
+        QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)))));
+    return content;
+}
+
+QList<QMcpCallToolResultContent> Tools::clipboardImageContent(const QImage &image, const QString &filePath)
+{
+    if (!filePath.isEmpty())
+        return clipboardImageResult(image, filePath);
+    if (image.sizeInBytes() > d->clipboardInlineLimit) {
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QStringLiteral("Error: clipboard image is %1x%2 (%3 bytes), above the %4 byte inline limit; pass filePath to save it")
+                .arg(image.width()).arg(image.height()).arg(image.sizeInBytes()).arg(d->clipboardInlineLimit))));
+        return content;
+    }
+    return d->imageResult(image);
+}
+
+void Tools::setClipboardLimits(int inlineLimit, int bufferLimit)
+{
+    const auto call = d->stats.call("setClipboardLimits");
+    d->clipboardInlineLimit = qMax(0, inlineLimit);
+    d->clipboardBufferLimit = qMax(0, bufferLimit);
+    if (qint64(d->lastClipboardText.size()) * qint64(sizeof(QChar)) > d->clipboardBufferLimit)
+        d->lastClipboardText.clear();
+    if (d->lastClipboardImage.sizeInBytes() > d->clipboardBufferLimit)
+        d->lastClipboardImage = QImage();
 }
 
 void Tools::setClipboard(const QString &text)
 {
+    const auto call = d->stats.call("setClipboard");
     d->vncClient.sendClipboardText(text);
 }
 
-QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboard(int timeout)
+QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboard(int timeout, const QString &filePath)
 {
+    auto call = d->stats.call("getClipboard");
     if (d->socket.state() != QTcpSocket::ConnectedState) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
@@ -1047,13 +2812,10 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboard(int timeout)
 
     // Check if clipboard data was already buffered (arrived between tool calls)
     if (!d->lastClipboardText.isEmpty()) {
-        const QString text = d->lastClipboardText;
-        d->lastClipboardText.clear();
+        const QString text = std::exchange(d->lastClipboardText, QString());
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
-        QList<QMcpCallToolResultContent> content;
-        content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
-        promise.addResult(content);
+        promise.addResult(clipboardTextResult(text, filePath, d->clipboardInlineLimit));
         promise.finish();
         return promise.future();
     }
@@ -1067,38 +2829,46 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboard(int timeout)
     timeoutTimer->setInterval(timeout);
 
     *conn = QObject::connect(&d->vncClient, &QVncClient::clipboardTextReceived, this,
-        [this, promise, conn, timeoutTimer](const QString &text) {
+        [this, promise, conn, timeoutTimer, filePath](const QString &text) {
             d->lastClipboardText.clear();
             QObject::disconnect(*conn);
             timeoutTimer->stop();
             timeoutTimer->deleteLater();
-            QList<QMcpCallToolResultContent> content;
-            content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
-            promise->addResult(content);
+            promise->addResult(clipboardTextResult(text, filePath, d->clipboardInlineLimit));
             promise->finish();
         });
 
-    QObject::connect(timeoutTimer, &QTimer::timeout, this, [promise, conn]() {
+    QObject::connect(timeoutTimer, &QTimer::timeout, this, [promise, conn, timeoutTimer]() {
         QObject::disconnect(*conn);
+        timeoutTimer->deleteLater();
         QList<QMcpCallToolResultContent> content;
         content.append(QMcpCallToolResultContent(QMcpTextContent(QStringLiteral("Error: no clipboard data received within timeout"))));
         promise->addResult(content);
         promise->finish();
     });
 
+    d->onCanceled(promise->future(), this, [promise, conn, timeoutTimer]() {
+        QObject::disconnect(*conn);
+        timeoutTimer->stop();
+        timeoutTimer->deleteLater();
+        promise->finish();
+    });
+
     timeoutTimer->start();
-    return promise->future();
+    return call.track(promise->future());
 }
 
 void Tools::setClipboardImage(const QString &filePath)
 {
+    const auto call = d->stats.call("setClipboardImage");
     QImage image(filePath);
     if (!image.isNull())
         d->vncClient.sendClipboardImage(image);
 }
 
-QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboardImage(int timeout)
+QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboardImage(int timeout, const QString &filePath)
 {
+    auto call = d->stats.call("getClipboardImage");
     if (d->socket.state() != QTcpSocket::ConnectedState) {
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
@@ -1111,11 +2881,10 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboardImage(int timeout)
 
     // Check if clipboard image was already buffered (arrived between tool calls)
     if (!d->lastClipboardImage.isNull()) {
-        const QImage image = d->lastClipboardImage;
-        d->lastClipboardImage = QImage();
+        const QImage image = std::exchange(d->lastClipboardImage, QImage());
         QPromise<QList<QMcpCallToolResultContent>> promise;
         promise.start();
-        promise.addResult(imageOrError(image));
+        promise.addResult(clipboardImageContent(image, filePath));
         promise.finish();
         return promise.future();
     }
@@ -1129,30 +2898,705 @@ QFuture<QList<QMcpCallToolResultContent>> Tools::getClipboardImage(int timeout)
     timeoutTimer->setInterval(timeout);
 
     *conn = QObject::connect(&d->vncClient, &QVncClient::clipboardImageReceived, this,
-        [this, promise, conn, timeoutTimer](const QImage &image) {
+        [this, promise, conn, timeoutTimer, filePath](const QImage &image) {
             d->lastClipboardImage = QImage();
             QObject::disconnect(*conn);
             timeoutTimer->stop();
             timeoutTimer->deleteLater();
-            promise->addResult(imageOrError(image));
+            promise->addResult(clipboardImageContent(image, filePath));
             promise->finish();
         });
 
-    QObject::connect(timeoutTimer, &QTimer::timeout, this, [promise, conn]() {
+    QObject::connect(timeoutTimer, &QTimer::timeout, this, [promise, conn, timeoutTimer]() {
         QObject::disconnect(*conn);
+        timeoutTimer->deleteLater();
         QList<QMcpCallToolResultContent> content;
         content.append(QMcpCallToolResultContent(QMcpTextContent(QStringLiteral("Error: no clipboard image received within timeout"))));
         promise->addResult(content);
         promise->finish();
     });
 
+    d->onCanceled(promise->future(), this, [promise, conn, timeoutTimer]() {
+        QObject::disconnect(*conn);
+        timeoutTimer->stop();
+        timeoutTimer->deleteLater();
+        promise->finish();
+    });
+
     timeoutTimer->start();
-    return promise->future();
+    return call.track(promise->future());
+}
+
+// --- Action and measurement tools ---
+
+static QFuture<QList<QMcpCallToolResultContent>> textResult(const QString &text)
+{
+    QPromise<QList<QMcpCallToolResultContent>> promise;
+    promise.start();
+    QList<QMcpCallToolResultContent> content;
+    content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
+    promise.addResult(content);
+    promise.finish();
+    return promise.future();
+}
+
+// Region in framebuffer coordinates; width/height of -1 extend to the edge
+static QRect regionRect(const QSize &framebufferSize, int x, int y, int width, int height)
+{
+    if (width < 0)
+        width = framebufferSize.width() - x;
+    if (height < 0)
+        height = framebufferSize.height() - y;
+    return QRect(x, y, width, height).intersected(QRect(QPoint(0, 0), framebufferSize));
+}
+
+static QJsonObject percentileSummary(QList<double> values)
+{
+    QJsonObject obj;
+    if (values.isEmpty())
+        return obj;
+    std::sort(values.begin(), values.end());
+    const auto percentile = [&values](double p) {
+        const qsizetype index = qBound<qsizetype>(0, qCeil(p * values.size()) - 1, values.size() - 1);
+        return values.at(index);
+    };
+    obj[QStringLiteral("min")] = values.first();
+    obj[QStringLiteral("median")] = percentile(0.5);
+    obj[QStringLiteral("p95")] = percentile(0.95);
+    obj[QStringLiteral("max")] = values.last();
+    return obj;
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::measureResponse(const QString &action, const QString &params, int x, int y, int width, int height, int timeout, int trials, int settle)
+{
+    auto call = d->stats.call("measureResponse");
+    if (!validActions.contains(action) || action == QLatin1String("waitForColor"))
+        return textResult(QStringLiteral("Error: '%1' is not an input action").arg(action));
+
+    QJsonParseError parseError;
+    const QJsonDocument paramDoc = QJsonDocument::fromJson(params.isEmpty() ? QByteArrayLiteral("{}") : params.toUtf8(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !paramDoc.isObject())
+        return textResult(QStringLiteral("Error: invalid params JSON: %1").arg(parseError.errorString()));
+
+    if (d->socket.state() != QTcpSocket::ConnectedState)
+        return textResult(QStringLiteral("Error: not connected"));
+
+    const QRect region = regionRect(d->vncClient.image().size(), x, y, width, height);
+    if (region.isEmpty())
+        return textResult(QStringLiteral("Error: no framebuffer available or region is out of bounds"));
+
+    struct Measurement
+    {
+        QElapsedTimer clock;
+        qint64 first = -1;
+        qint64 last = -1;
+        int trial = 0;
+        QList<double> firstMs;
+        QList<double> lastMs;
+        QJsonArray samples;
+        QMetaObject::Connection connImg;
+    };
+
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+
+    auto state = QSharedPointer<Measurement>::create();
+    const QJsonObject stepParams = paramDoc.object();
+    trials = qBound(1, trials, 100);
+    settle = qMax(0, settle);
+
+    auto quietTimer = new QTimer(this);
+    quietTimer->setSingleShot(true);
+    auto timeoutTimer = new QTimer(this);
+    timeoutTimer->setSingleShot(true);
+
+    auto startTrial = QSharedPointer<std::function<void()>>::create();
+    auto finishTrial = QSharedPointer<std::function<void()>>::create();
+
+    *startTrial = [this, promise, state, action, stepParams, region, timeout, settle, quietTimer, timeoutTimer]() {
+        // The pause between trials outlives a cancel
+        if (promise->future().isCanceled())
+            return;
+        state->first = -1;
+        state->last = -1;
+        state->connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
+            [state, region, settle, quietTimer](const QRect &rect) {
+                if (!rect.intersects(region))
+                    return;
+                const qint64 now = state->clock.nsecsElapsed();
+                if (state->first < 0)
+                    state->first = now;
+                state->last = now;
+                quietTimer->start(settle);
+            });
+        executeStep(action, stepParams, []() {});
+        // Time from the moment the input leaves our send buffer
+        d->socket.flush();
+        state->clock.start();
+        timeoutTimer->start(timeout);
+    };
+
+    *finishTrial = [this, promise, state, startTrial, trials, settle, quietTimer, timeoutTimer]() {
+        QObject::disconnect(state->connImg);
+        quietTimer->stop();
+        timeoutTimer->stop();
+
+        QJsonObject sample;
+        if (state->first >= 0) {
+            state->firstMs.append(state->first / 1e6);
+            state->lastMs.append(state->last / 1e6);
+            sample[QStringLiteral("firstMs")] = state->first / 1e6;
+            sample[QStringLiteral("lastMs")] = state->last / 1e6;
+        } else {
+            sample[QStringLiteral("responded")] = false;
+        }
+        state->samples.append(sample);
+
+        if (++state->trial < trials) {
+            // Let the UI settle back before the next trial
+            QTimer::singleShot(settle, this, [startTrial]() {
+                (*startTrial)();
+            });
+            return;
+        }
+
+        quietTimer->deleteLater();
+        timeoutTimer->deleteLater();
+        d->releaseUpdates();
+
+        // Input needs half an RTT to reach the server and the damage half an
+        // RTT to come back, so the application's own share is raw - RTT.
+        const double rtt = d->link.hasRtt() ? d->link.rttMs() : 0.0;
+        const auto corrected = [rtt](QList<double> values) {
+            for (double &v : values)
+                v = qMax(0.0, v - rtt);
+            return values;
+        };
+
+        QJsonObject result;
+        result[QStringLiteral("trials")] = trials;
+        result[QStringLiteral("responded")] = state->firstMs.size();
+        result[QStringLiteral("rttMs")] = rtt;
+        result[QStringLiteral("firstDamageMs")] = percentileSummary(state->firstMs);
+        result[QStringLiteral("lastDamageMs")] = percentileSummary(state->lastMs);
+        result[QStringLiteral("correctedFirstDamageMs")] = percentileSummary(corrected(state->firstMs));
+        result[QStringLiteral("correctedLastDamageMs")] = percentileSummary(corrected(state->lastMs));
+        result[QStringLiteral("samples")] = state->samples;
+
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)))));
+        promise->addResult(content);
+        promise->finish();
+    };
+
+    QObject::connect(quietTimer, &QTimer::timeout, this, [finishTrial]() {
+        (*finishTrial)();
+    });
+    QObject::connect(timeoutTimer, &QTimer::timeout, this, [finishTrial]() {
+        (*finishTrial)();
+    });
+
+    const quint64 waiter = d->withLiveUpdates([startTrial]() {
+        (*startTrial)();
+    });
+    d->onCanceled(promise->future(), this, [this, promise, state, quietTimer, timeoutTimer, waiter]() {
+        QObject::disconnect(state->connImg);
+        quietTimer->stop();
+        timeoutTimer->stop();
+        quietTimer->deleteLater();
+        timeoutTimer->deleteLater();
+        d->leaveRefresh(waiter);
+        d->releaseUpdates();
+        promise->finish();
+    });
+
+    return call.track(promise->future());
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::actAndCapture(const QString &action, const QString &params, int timeout, int settle, bool fullScreen)
+{
+    auto call = d->stats.call("actAndCapture");
+    if (!validActions.contains(action) || action == QLatin1String("waitForColor"))
+        return textResult(QStringLiteral("Error: '%1' is not an input action").arg(action));
+
+    QJsonParseError parseError;
+    const QJsonDocument paramDoc = QJsonDocument::fromJson(params.isEmpty() ? QByteArrayLiteral("{}") : params.toUtf8(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !paramDoc.isObject())
+        return textResult(QStringLiteral("Error: invalid params JSON: %1").arg(parseError.errorString()));
+
+    if (d->socket.state() != QTcpSocket::ConnectedState)
+        return textResult(QStringLiteral("Error: not connected"));
+
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+
+    auto damage = QSharedPointer<QRect>::create();
+    auto connImg = QSharedPointer<QMetaObject::Connection>::create();
+    auto quietTimer = new QTimer(this);
+    quietTimer->setSingleShot(true);
+    auto timeoutTimer = new QTimer(this);
+    timeoutTimer->setSingleShot(true);
+    settle = qMax(0, settle);
+
+    // Finishes early once the screen has been quiet for settle ms after
+    // changing; the timeout is a hard deadline from the action, so a screen
+    // that keeps changing returns what changed so far instead of waiting on
+    auto finish = [this, promise, damage, connImg, quietTimer, timeoutTimer, timeout, fullScreen](bool settled) {
+        QObject::disconnect(*connImg);
+        quietTimer->stop();
+        timeoutTimer->stop();
+        quietTimer->deleteLater();
+        timeoutTimer->deleteLater();
+        d->releaseUpdates();
+
+        QImage img = d->composite(d->vncClient.image());
+        QList<QMcpCallToolResultContent> content;
+        if (damage->isEmpty()) {
+            content.append(QMcpCallToolResultContent(QMcpTextContent(
+                QStringLiteral("No change detected; returning the full screen"))));
+            content.append(d->imageResult(img));
+        } else {
+            const QRect rect = fullScreen ? img.rect() : damage->intersected(img.rect());
+            QString text = QStringLiteral("Changed region: x=%1, y=%2, width=%3, height=%4")
+                               .arg(damage->x()).arg(damage->y()).arg(damage->width()).arg(damage->height());
+            if (!settled)
+                text += QStringLiteral(" (did not settle: still changing at the %1 ms timeout)").arg(timeout);
+            content.append(QMcpCallToolResultContent(QMcpTextContent(text)));
+            content.append(d->imageResult(extractRegion(img, rect.x(), rect.y(), rect.width(), rect.height())));
+        }
+        promise->addResult(content);
+        promise->finish();
+    };
+    QObject::connect(quietTimer, &QTimer::timeout, this, [finish]() { finish(true); });
+    QObject::connect(timeoutTimer, &QTimer::timeout, this, [finish]() { finish(false); });
+
+    const QJsonObject stepParams = paramDoc.object();
+    const quint64 waiter = d->withLiveUpdates([this, action, stepParams, damage, connImg, quietTimer, timeoutTimer, timeout, settle]() {
+        *connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
+            [damage, quietTimer, settle](const QRect &rect) {
+                *damage |= rect;
+                // The quiet period only counts once the UI has started reacting
+                quietTimer->start(settle);
+            });
+        executeStep(action, stepParams, []() {});
+        timeoutTimer->start(timeout);
+    });
+    d->onCanceled(promise->future(), this, [this, promise, connImg, quietTimer, timeoutTimer, waiter]() {
+        QObject::disconnect(*connImg);
+        quietTimer->stop();
+        timeoutTimer->stop();
+        quietTimer->deleteLater();
+        timeoutTimer->deleteLater();
+        d->leaveRefresh(waiter);
+        d->releaseUpdates();
+        promise->finish();
+    });
+
+    return call.track(promise->future());
+}
+
+static size_t regionHash(const QImage &image, const QRect &region)
+{
+    size_t hash = 0;
+    const qsizetype rowBytes = qsizetype(region.width()) * image.depth() / 8;
+    const qsizetype offset = qsizetype(region.x()) * image.depth() / 8;
+    for (int row = region.top(); row <= region.bottom(); ++row)
+        hash = qHashBits(image.constScanLine(row) + offset, rowBytes, hash);
+    return hash;
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::measureFrameRate(int x, int y, int width, int height, int duration, int stallThreshold)
+{
+    auto call = d->stats.call("measureFrameRate");
+    if (d->socket.state() != QTcpSocket::ConnectedState)
+        return textResult(QStringLiteral("Error: not connected"));
+
+    const QRect region = regionRect(d->vncClient.image().size(), x, y, width, height);
+    if (region.isEmpty())
+        return textResult(QStringLiteral("Error: no framebuffer available or region is out of bounds"));
+
+    struct Meter
+    {
+        QElapsedTimer clock;
+        size_t hash = 0;
+        bool dirty = false;
+        QList<qint64> frames;
+        QMetaObject::Connection connImg;
+        QMetaObject::Connection connFb;
+    };
+
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+
+    duration = qMax(100, duration);
+    stallThreshold = qMax(1, stallThreshold);
+    auto meter = QSharedPointer<Meter>::create();
+    auto timer = new QTimer(this);
+    timer->setSingleShot(true);
+
+    QObject::connect(timer, &QTimer::timeout, this, [this, promise, meter, timer, duration, stallThreshold]() {
+        QObject::disconnect(meter->connImg);
+        QObject::disconnect(meter->connFb);
+        timer->deleteLater();
+        d->releaseUpdates();
+
+        QList<double> frameTimes;
+        QJsonArray stalls;
+        double longestStall = 0;
+        for (qsizetype i = 1; i < meter->frames.size(); ++i) {
+            const double ms = (meter->frames.at(i) - meter->frames.at(i - 1)) / 1e6;
+            frameTimes.append(ms);
+            if (ms >= stallThreshold) {
+                QJsonObject stall;
+                stall[QStringLiteral("atMs")] = meter->frames.at(i - 1) / 1e6;
+                stall[QStringLiteral("durationMs")] = ms;
+                stalls.append(stall);
+                longestStall = qMax(longestStall, ms);
+            }
+        }
+
+        QJsonObject result;
+        result[QStringLiteral("durationMs")] = duration;
+        result[QStringLiteral("frames")] = meter->frames.size();
+        result[QStringLiteral("fps")] = meter->frames.size() * 1000.0 / duration;
+        result[QStringLiteral("frameTimeMs")] = percentileSummary(frameTimes);
+        result[QStringLiteral("stallThresholdMs")] = stallThreshold;
+        result[QStringLiteral("longestStallMs")] = longestStall;
+        result[QStringLiteral("stalls")] = stalls;
+
+        QList<QMcpCallToolResultContent> content;
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)))));
+        promise->addResult(content);
+        promise->finish();
+    });
+
+    // Frames are distinct region contents, not update messages: a server that
+    // resends unchanged pixels must not inflate the rate. Counting starts once
+    // updates flow, so the full refresh that turning them on triggers is the
+    // baseline rather than the first frame and the first stall boundary.
+    const quint64 waiter = d->withLiveUpdates([this, meter, region, timer, duration]() {
+        meter->hash = regionHash(d->vncClient.image(), region);
+        meter->clock.start();
+        meter->connImg = QObject::connect(&d->vncClient, &QVncClient::imageChanged, this,
+            [meter, region](const QRect &rect) {
+                if (rect.intersects(region))
+                    meter->dirty = true;
+            });
+        meter->connFb = QObject::connect(&d->vncClient, &QVncClient::framebufferUpdated, this,
+            [this, meter, region]() {
+                if (!meter->dirty)
+                    return;
+                meter->dirty = false;
+                const size_t hash = regionHash(d->vncClient.image(), region);
+                if (hash == meter->hash)
+                    return;
+                meter->hash = hash;
+                meter->frames.append(meter->clock.nsecsElapsed());
+            });
+        timer->start(duration);
+    });
+    d->onCanceled(promise->future(), this, [this, promise, meter, timer, waiter]() {
+        QObject::disconnect(meter->connImg);
+        QObject::disconnect(meter->connFb);
+        timer->stop();
+        timer->deleteLater();
+        d->leaveRefresh(waiter);
+        d->releaseUpdates();
+        promise->finish();
+    });
+
+    return call.track(promise->future());
+}
+
+// Parses "x,y,w,h;x,y,w,h" into rectangles
+static bool parseRects(const QString &text, QList<QRect> *rects)
+{
+    for (const QString &entry : text.split(QLatin1Char(';'), Qt::SkipEmptyParts)) {
+        const QStringList parts = entry.split(QLatin1Char(','));
+        if (parts.size() != 4)
+            return false;
+        int values[4];
+        for (int i = 0; i < 4; ++i) {
+            bool ok = false;
+            values[i] = parts.at(i).trimmed().toInt(&ok);
+            if (!ok)
+                return false;
+        }
+        rects->append(QRect(values[0], values[1], values[2], values[3]));
+    }
+    return true;
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::compareWithImage(const QString &filePath, int x, int y, int width, int height, int tolerance, const QString &ignoreMasks, const QString &diffPath, const QString &snapshot)
+{
+    auto call = d->stats.call("compareWithImage");
+    QList<QRect> ignore;
+    if (!parseRects(ignoreMasks, &ignore))
+        return textResult(QStringLiteral("Error: invalid ignoreMasks '%1'. Use \"x,y,width,height;...\".").arg(ignoreMasks));
+
+    const QFileInfo info(filePath);
+    if (filePath != d->goldenPath || info.lastModified() != d->goldenModified) {
+        d->golden = QImage(filePath);
+        d->goldenPath = filePath;
+        d->goldenModified = info.lastModified();
+    }
+    if (d->golden.isNull()) {
+        d->goldenPath.clear();
+        return textResult(QStringLiteral("Error: cannot load image '%1'").arg(filePath));
+    }
+
+    Snapshot *snap = nullptr;
+    if (!snapshot.isEmpty()) {
+        snap = d->snapshots.object(snapshot);
+        if (!snap)
+            return textResult(QStringLiteral("Error: unknown or expired snapshot '%1'").arg(snapshot));
+    }
+
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+    // The frame may arrive after another call has replaced the cached golden
+    const QImage golden = d->golden;
+    auto compare = [promise, golden, x, y, width, height, tolerance, ignore, diffPath](const QImage &frame) {
+        const QRect region = regionRect(frame.size(), x, y, width, height);
+        QList<QMcpCallToolResultContent> content;
+        if (region.size() != golden.size()) {
+            content.append(QMcpCallToolResultContent(QMcpTextContent(
+                QStringLiteral("Error: image is %1x%2 but the region is %3x%4")
+                    .arg(golden.width()).arg(golden.height()).arg(region.width()).arg(region.height()))));
+            promise->addResult(content);
+            promise->finish();
+            return;
+        }
+        // Masks are given in framebuffer coordinates
+        QList<QRect> masks;
+        for (const QRect &rect : ignore)
+            masks.append(rect.translated(-region.topLeft()));
+
+        QElapsedTimer timer;
+        timer.start();
+        QImage heatMap;
+        const ImageDiff diff = ImageDiff::compare(frame.copy(region), golden, tolerance, masks,
+                                                  diffPath.isEmpty() ? nullptr : &heatMap);
+        const qint64 elapsed = timer.nsecsElapsed();
+        Tracer::instance()->complete("compareWithImage", "frame", elapsed);
+
+        QJsonArray areas;
+        for (const ImageDiff::Area &area : diff.areas) {
+            QJsonObject obj;
+            obj[QStringLiteral("x")] = area.rect.x() + region.x();
+            obj[QStringLiteral("y")] = area.rect.y() + region.y();
+            obj[QStringLiteral("width")] = area.rect.width();
+            obj[QStringLiteral("height")] = area.rect.height();
+            obj[QStringLiteral("pixels")] = area.pixels;
+            areas.append(obj);
+        }
+        QJsonObject result;
+        result[QStringLiteral("mismatchPercent")] = diff.comparedPixels > 0
+            ? 100.0 * double(diff.differingPixels) / double(diff.comparedPixels) : 0.0;
+        result[QStringLiteral("differingPixels")] = diff.differingPixels;
+        result[QStringLiteral("comparedPixels")] = diff.comparedPixels;
+        result[QStringLiteral("areas")] = areas;
+        result[QStringLiteral("compareMs")] = double(elapsed) / 1e6;
+        if (!diffPath.isEmpty()) {
+            if (heatMap.save(diffPath))
+                result[QStringLiteral("diffPath")] = diffPath;
+            else
+                result[QStringLiteral("diffError")] = QStringLiteral("cannot write %1").arg(diffPath);
+        }
+        content.append(QMcpCallToolResultContent(QMcpTextContent(
+            QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)))));
+        promise->addResult(content);
+        promise->finish();
+    };
+
+    // Compared like save writes frames: with the cursor composited
+    if (snap) {
+        if (snap->composited.isNull())
+            snap->composited = d->composite(snap->framebuffer, snap->cursor);
+        compare(snap->composited);
+        return call.track(promise->future());
+    }
+    d->withExactFrame(promise, this, [this, compare]() {
+        compare(d->composite(d->vncClient.image()));
+    });
+    return call.track(promise->future());
+}
+
+#ifdef HAVE_TESSERACT
+// --- Text recognition tools ---
+
+static QJsonObject wordJson(const TextRecognizer::Word &word)
+{
+    QJsonObject obj;
+    obj[QStringLiteral("text")] = word.text;
+    obj[QStringLiteral("x")] = word.box.x();
+    obj[QStringLiteral("y")] = word.box.y();
+    obj[QStringLiteral("width")] = word.box.width();
+    obj[QStringLiteral("height")] = word.box.height();
+    obj[QStringLiteral("confidence")] = word.confidence;
+    return obj;
+}
+
+static bool sameLine(const QRect &a, const QRect &b)
+{
+    return a.center().y() >= b.top() && a.center().y() <= b.bottom();
+}
+
+// Words in reading order: grouped into lines top to bottom, a word joining
+// the line whose first word it overlaps vertically, then left to right
+static QList<TextRecognizer::Word> readingOrder(QList<TextRecognizer::Word> words, int minConfidence)
+{
+    words.removeIf([minConfidence](const TextRecognizer::Word &word) {
+        return word.confidence < minConfidence;
+    });
+    std::sort(words.begin(), words.end(), [](const auto &a, const auto &b) {
+        return a.box.center().y() < b.box.center().y();
+    });
+    QList<std::pair<std::pair<int, int>, qsizetype>> order;
+    order.reserve(words.size());
+    int line = 0;
+    for (qsizetype i = 0, first = 0; i < words.size(); ++i) {
+        if (!sameLine(words.at(i).box, words.at(first).box)) {
+            ++line;
+            first = i;
+        }
+        order.append({ { line, words.at(i).box.x() }, i });
+    }
+    std::sort(order.begin(), order.end());
+    QList<TextRecognizer::Word> sorted;
+    sorted.reserve(words.size());
+    for (const auto &entry : std::as_const(order))
+        sorted.append(words.at(entry.second));
+    return sorted;
 }
 
+static QString normalizedWord(const QString &word)
+{
+    QString result;
+    for (QChar c : word) {
+        if (c.isLetterOrNumber())
+            result += c.toCaseFolded();
+    }
+    return result;
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::readText(int x, int y, int width, int height, int minConfidence)
+{
+    auto call = d->stats.call("readText");
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+    d->withExactFrame(promise, this, [this, promise, x, y, width, height, minConfidence]() {
+        const QRect region = regionRect(d->vncClient.image().size(), x, y, width, height);
+        d->recognizeText(region).then(this, [promise, minConfidence](const TextRecognition &recognition) {
+            if (!recognition.error.isEmpty()) {
+                QList<QMcpCallToolResultContent> content;
+                content.append(QMcpCallToolResultContent(QMcpTextContent(
+                    QStringLiteral("Error: %1").arg(recognition.error))));
+                promise->addResult(content);
+                promise->finish();
+                return;
+            }
+            const auto words = readingOrder(recognition.words, minConfidence);
+
+            QString text;
+            QJsonArray wordArray;
+            for (qsizetype i = 0; i < words.size(); ++i) {
+                if (i > 0)
+                    text += sameLine(words.at(i).box, words.at(i - 1).box) ? QLatin1Char(' ') : QLatin1Char('\n');
+                text += words.at(i).text;
+                wordArray.append(wordJson(words.at(i)));
+            }
+            QJsonObject result;
+            result[QStringLiteral("text")] = text;
+            result[QStringLiteral("words")] = wordArray;
+            result[QStringLiteral("bands")] = recognition.stats.bands;
+            result[QStringLiteral("recognizedBands")] = recognition.stats.recognized;
+
+            QList<QMcpCallToolResultContent> content;
+            content.append(QMcpCallToolResultContent(QMcpTextContent(
+                QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)))));
+            promise->addResult(content);
+            promise->finish();
+        });
+    });
+    return call.track(promise->future());
+}
+
+QFuture<QList<QMcpCallToolResultContent>> Tools::findText(const QString &text, int x, int y, int width, int height, int minConfidence)
+{
+    auto call = d->stats.call("findText");
+    QStringList tokens;
+    for (const QString &token : text.split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+        const QString normalized = normalizedWord(token);
+        if (!normalized.isEmpty())
+            tokens.append(normalized);
+    }
+    if (tokens.isEmpty())
+        return textResult(QStringLiteral("Error: no text to find"));
+    auto promise = QSharedPointer<QPromise<QList<QMcpCallToolResultContent>>>::create();
+    promise->start();
+    d->withExactFrame(promise, this, [this, promise, text, tokens, x, y, width, height, minConfidence]() {
+        const QRect region = regionRect(d->vncClient.image().size(), x, y, width, height);
+        d->recognizeText(region).then(this, [promise, text, tokens, minConfidence](const TextRecognition &recognition) {
+            if (!recognition.error.isEmpty()) {
+                QList<QMcpCallToolResultContent> content;
+                content.append(QMcpCallToolResultContent(QMcpTextContent(
+                    QStringLiteral("Error: %1").arg(recognition.error))));
+                promise->addResult(content);
+                promise->finish();
+                return;
+            }
+            const auto words = readingOrder(recognition.words, minConfidence);
+
+            // A phrase matches consecutive words on one line; a single word may
+            // also be part of a longer one ("Save" in "Save As...")
+            QJsonArray matches;
+            for (qsizetype i = 0; i + tokens.size() <= words.size(); ++i) {
+                QRect box;
+                bool match = true;
+                for (qsizetype t = 0; t < tokens.size() && match; ++t) {
+                    const auto &word = words.at(i + t);
+                    const QString normalized = normalizedWord(word.text);
+                    match = tokens.size() == 1 ? normalized.contains(tokens.at(t)) : normalized == tokens.at(t);
+                    match = match && (t == 0 || sameLine(word.box, words.at(i).box));
+                    box |= word.box;
+                }
+                if (!match)
+                    continue;
+                QJsonObject obj;
+                obj[QStringLiteral("x")] = box.x();
+                obj[QStringLiteral("y")] = box.y();
+                obj[QStringLiteral("width")] = box.width();
+                obj[QStringLiteral("height")] = box.height();
+                obj[QStringLiteral("clickX")] = box.center().x();
+                obj[QStringLiteral("clickY")] = box.center().y();
+                matches.append(obj);
+            }
+
+            QList<QMcpCallToolResultContent> content;
+            if (matches.isEmpty()) {
+                content.append(QMcpCallToolResultContent(QMcpTextContent(
+                    QStringLiteral("Error: text '%1' not found").arg(text))));
+            } else {
+                QJsonObject result;
+                result[QStringLiteral("matches")] = matches;
+                content.append(QMcpCallToolResultContent(QMcpTextContent(
+                    QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)))));
+            }
+            promise->addResult(content);
+            promise->finish();
+        });
+    });
+    return call.track(promise->future());
+}
+#endif
+
 #ifdef HAVE_MULTIMEDIA
 bool Tools::startRecording(const QString &filePath, int fps)
 {
+    const auto call = d->stats.call("startRecording");
     if (d->recording)
         return false;
     if (d->socket.state() != QTcpSocket::ConnectedState)
@@ -1195,7 +3639,7 @@ bool Tools::startRecording(const QString &filePath, int fps)
         if (img.isNull())
             return;
         d->readyForFrame = false;
-        QImage composited = compositeWithCursor(img, &d->vncClient, d->pos);
+        QImage composited = d->composite(img);
         QVideoFrame frame(composited.convertToFormat(QImage::Format_ARGB32));
         frame.setStreamFrameRate(d->recordingFps);
         d->videoFrameInput->sendVideoFrame(frame);
@@ -1212,6 +3656,7 @@ bool Tools::startRecording(const QString &filePath, int fps)
 
 bool Tools::stopRecording()
 {
+    const auto call = d->stats.call("stopRecording");
     if (!d->recording)
         return false;
 
@@ -1237,6 +3682,7 @@ bool Tools::stopRecording()
 
 QString Tools::getRecordingStatus() const
 {
+    const auto call = d->stats.call("getRecordingStatus");
     if (!d->recording)
         return QStringLiteral("{\"recording\":false}");
     return QStringLiteral("{\"recording\":true,\"fps\":%1}")
@@ -8,13 +8,12 @@
 #include <QtCore/QFuture>
 #include <QtCore/QObject>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QUuid>
 #include <QtGui/QImage>
 #include <QtCore/QJsonObject>
 #include <QtMcpCommon/qmcpcalltoolresultcontent.h>
 
 class QVncClient;
-class QWidget;
-class VncWidget;
 
 class Tools : public QObject
 {
@@ -24,14 +23,30 @@ public:
     ~Tools() override;
 
     QVncClient *client() const;
-    void setPreviewWidget(VncWidget *widget);
 
-    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> connect(const QString &host, int port, const QString &password = QString(), const QString &username = QString(), int timeout = 30000);
-    Q_INVOKABLE void disconnect();
-    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> screenshot(int x = 0, int y = 0, int width = -1, int height = -1);
+    // MCP session of the tool call being dispatched. Sessions share the VNC
+    // connection; disconnect and periodic stats are accounted per session.
+    // A null session stands for an unknown caller.
+    void setSession(const QUuid &session);
+    void detachSession(const QUuid &session);
+
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> connect(const QString &host, int port = 5900, const QString &password = QString(), const QString &username = QString(), int timeout = 30000, const QString &encodings = QString(), int quality = -1, int compression = -1);
+    Q_INVOKABLE bool disconnect();
+    Q_INVOKABLE QString setEncodings(const QString &encodings, int quality = -1, int compression = -1);
+    Q_INVOKABLE QString setReducedQuality(int quality);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> screenshot(int x = 0, int y = 0, int width = -1, int height = -1, const QString &snapshot = QString());
     Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> save(const QString &filePath, int x = 0, int y = 0, int width = -1, int height = -1);
+    Q_INVOKABLE QString setScreenshotStore(const QString &directory, const QString &format = QStringLiteral("png"), bool hardLinks = false);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> snapshot();
+    Q_INVOKABLE bool releaseSnapshot(const QString &snapshot);
+    Q_INVOKABLE QString getSharedFramebuffer();
+    Q_INVOKABLE bool stopSharedFramebuffer();
     Q_INVOKABLE QString status() const;
     Q_INVOKABLE QString getCursorInfo() const;
+    Q_INVOKABLE QString getStats() const;
+    Q_INVOKABLE void setStatsInterval(int interval);
+    Q_INVOKABLE bool startTrace(const QString &filePath);
+    Q_INVOKABLE QString stopTrace();
     Q_INVOKABLE void mouseMove(int x, int y, int button = 0);
     Q_INVOKABLE void mouseClick(int x, int y, int button = 1);
     Q_INVOKABLE void doubleClick(int x, int y, int button = 1);
@@ -42,27 +57,47 @@ public:
     Q_INVOKABLE void sendKey(int keysym, bool down);
     Q_INVOKABLE void sendKey(const QString &keysym, bool down);
     Q_INVOKABLE void sendText(const QString &text);
+    Q_INVOKABLE void setInputBurst(int window = -1);
+    Q_INVOKABLE void setUpdatePipelining(int depth = -1);
     Q_INVOKABLE void setPreview(bool visible);
     Q_INVOKABLE void setInteractive(bool enabled);
     Q_INVOKABLE void setStaysOnTop(bool enabled);
     Q_INVOKABLE void setPreviewTitle(const QString &title);
+    Q_INVOKABLE void setPreviewFrameRate(int fps);
+    Q_INVOKABLE void setPreviewScaled(bool enabled);
     // Macro tools
     Q_INVOKABLE void setMacroDir(const QString &path);
     Q_INVOKABLE bool createMacro(const QString &name, const QString &description = QString());
     Q_INVOKABLE bool addMacroStep(const QString &name, const QString &action, const QString &params, int delay = 0);
     Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> playMacro(const QString &name, int speedFactor = 100);
+    Q_INVOKABLE bool cancelMacro();
     Q_INVOKABLE QStringList listMacros();
     Q_INVOKABLE QString getMacro(const QString &name);
     Q_INVOKABLE bool deleteMacro(const QString &name);
 
-    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> checkPixelColor(int x, int y, const QString &color, qreal similarity = 1.0);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> checkPixelColor(int x, int y, const QString &color, qreal similarity = 1.0, const QString &snapshot = QString());
     Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> waitForColor(int x, int y, const QString &color, int timeout = 30000, qreal similarity = 1.0);
+    Q_INVOKABLE QString watchRegion(int x, int y, int width = -1, int height = -1, const QString &condition = QStringLiteral("change"), const QString &color = QString(), const QString &templatePath = QString(), qreal similarity = 1.0, bool once = true);
+    Q_INVOKABLE bool unwatchRegion(const QString &watch);
 
     // Clipboard tools
     Q_INVOKABLE void setClipboard(const QString &text);
-    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> getClipboard(int timeout = 5000);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> getClipboard(int timeout = 5000, const QString &filePath = QString());
     Q_INVOKABLE void setClipboardImage(const QString &filePath);
-    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> getClipboardImage(int timeout = 5000);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> getClipboardImage(int timeout = 5000, const QString &filePath = QString());
+    Q_INVOKABLE void setClipboardLimits(int inlineLimit = 1048576, int bufferLimit = 67108864);
+
+    // Action and measurement tools
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> actAndCapture(const QString &action, const QString &params, int timeout = 5000, int settle = 300, bool fullScreen = false);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> measureResponse(const QString &action, const QString &params, int x = 0, int y = 0, int width = -1, int height = -1, int timeout = 5000, int trials = 1, int settle = 500);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> measureFrameRate(int x = 0, int y = 0, int width = -1, int height = -1, int duration = 2000, int stallThreshold = 50);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> compareWithImage(const QString &filePath, int x = 0, int y = 0, int width = -1, int height = -1, int tolerance = 0, const QString &ignoreMasks = QString(), const QString &diffPath = QString(), const QString &snapshot = QString());
+
+#ifdef HAVE_TESSERACT
+    // Text recognition tools
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> readText(int x = 0, int y = 0, int width = -1, int height = -1, int minConfidence = 50);
+    Q_INVOKABLE QFuture<QList<QMcpCallToolResultContent>> findText(const QString &text, int x = 0, int y = 0, int width = -1, int height = -1, int minConfidence = 50);
+#endif
 
 #ifdef HAVE_MULTIMEDIA
     Q_INVOKABLE bool startRecording(const QString &filePath, int fps = 10);
@@ -72,9 +107,14 @@ public:
 
 signals:
     void disconnected();
+    void statsReported(const QUuid &session, const QJsonObject &stats);
+    void regionWatchTriggered(const QUuid &session, const QJsonObject &event);
 
 private:
+    QJsonObject collectStats() const;
     void executeStep(const QString &action, const QJsonObject &params, std::function<void()> onCompleted);
+    QList<QMcpCallToolResultContent> clipboardImageContent(const QImage &image, const QString &filePath);
+    void evaluateWatches();
     class Private;
     QScopedPointer<Private> d;
 };
@@ -0,0 +1,78 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "trace.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+
+Tracer *Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+Tracer::Tracer()
+{
+    m_clock.start();
+}
+
+void Tracer::addEvent(const char *name, const char *category, char phase, qint64 start, qint64 duration, quint64 id)
+{
+    if (m_events.size() >= MaxEvents) {
+        ++m_dropped;
+        return;
+    }
+    m_events.append({ name, category, phase, start, duration, id });
+}
+
+bool Tracer::start(const QString &filePath)
+{
+    if (isEnabled() || filePath.isEmpty())
+        return false;
+    m_filePath = filePath;
+    m_events.clear();
+    m_events.reserve(4096);
+    m_dropped = 0;
+    m_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool Tracer::stop()
+{
+    if (!isEnabled())
+        return false;
+    m_enabled.store(false, std::memory_order_relaxed);
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_events.clear();
+        return false;
+    }
+
+    // Written by hand rather than through QJsonDocument: traces can hold a
+    // million events and the DOM would triple peak memory.
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    file.write("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":");
+    file.write(QByteArray::number(m_dropped));
+    file.write("},\"traceEvents\":[\n");
+    for (qsizetype i = 0; i < m_events.size(); ++i) {
+        const Event &event = m_events.at(i);
+        QByteArray line = "{\"name\":\"" + QByteArray(event.name)
+            + "\",\"cat\":\"" + QByteArray(event.category)
+            + "\",\"ph\":\"" + QByteArray(1, event.phase)
+            + "\",\"ts\":" + QByteArray::number(event.start / 1000.0, 'f', 3)
+            + ",\"pid\":" + pid + ",\"tid\":1";
+        if (event.phase == 'X')
+            line += ",\"dur\":" + QByteArray::number(event.duration / 1000.0, 'f', 3);
+        else if (event.phase == 'b' || event.phase == 'e')
+            line += ",\"id\":\"0x" + QByteArray::number(event.id, 16) + '"';
+        else
+            line += ",\"s\":\"t\"";
+        line += i + 1 < m_events.size() ? "},\n" : "}\n";
+        file.write(line);
+    }
+    file.write("]}\n");
+    m_events.clear();
+    m_events.squeeze();
+    return true;
+}
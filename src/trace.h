@@ -0,0 +1,80 @@
+// Copyright (C) 2025 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+// Records spans in Chrome trace-event format (loadable in chrome://tracing
+// and ui.perfetto.dev). When tracing is off every entry point is a single
+// relaxed atomic load, so call sites stay compiled in for release builds.
+// Not thread-safe: spans must be recorded from the main thread.
+class Tracer
+{
+public:
+    static Tracer *instance();
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    // Monotonic nanoseconds since process start
+    qint64 timestamp() const { return m_clock.nsecsElapsed(); }
+
+    // Records a span that ended now and lasted durationNsecs
+    void complete(const char *name, const char *category, qint64 durationNsecs)
+    {
+        if (isEnabled())
+            addEvent(name, category, 'X', timestamp() - durationNsecs, durationNsecs);
+    }
+    // Records a span that ended now as an async begin/end pair with its own
+    // id. For work that can overlap other spans on the main thread, such as
+    // asynchronous tool calls: nested 'X' events would have to be properly
+    // stacked to render.
+    void async(const char *name, const char *category, qint64 durationNsecs)
+    {
+        if (isEnabled()) {
+            const quint64 id = ++m_lastAsyncId;
+            addEvent(name, category, 'b', timestamp() - durationNsecs, 0, id);
+            addEvent(name, category, 'e', timestamp(), 0, id);
+        }
+    }
+    void instant(const char *name, const char *category)
+    {
+        if (isEnabled())
+            addEvent(name, category, 'i', timestamp(), 0);
+    }
+
+    bool start(const QString &filePath);
+    bool stop();
+    QString filePath() const { return m_filePath; }
+    qsizetype eventCount() const { return m_events.size(); }
+
+private:
+    Tracer();
+
+    struct Event
+    {
+        const char *name;
+        const char *category;
+        char phase;
+        qint64 start;
+        qint64 duration;
+        quint64 id;
+    };
+
+    void addEvent(const char *name, const char *category, char phase, qint64 start, qint64 duration, quint64 id = 0);
+
+    // Bounds memory if a trace is left running: ~40 MB of events
+    static constexpr qsizetype MaxEvents = 1 << 20;
+
+    std::atomic<bool> m_enabled { false };
+    QElapsedTimer m_clock;
+    QString m_filePath;
+    QList<Event> m_events;
+    qsizetype m_dropped = 0;
+    quint64 m_lastAsyncId = 0;
+};
+
+#endif // TRACE_H
@@ -3,11 +3,14 @@
 
 #include "vncwidget.h"
 
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTimer>
 #include <QtGui/QCloseEvent>
 #include <QtGui/QPainter>
 #include <QtGui/QPaintEvent>
 #include <QtGui/QKeyEvent>
 #include <QtGui/QMouseEvent>
+#include <QtGui/QResizeEvent>
 
 class VncWidget::Private
 {
@@ -15,6 +18,18 @@ public:
     Private(VncWidget *parent);
     
     void paint(const QRect &rect);
+    void updateSize();
+
+    // Damage is collected in framebuffer coordinates and flushed at most
+    // once per frame interval
+    void addDamage(const QRect &rect);
+    void flushDamage();
+    void updateCursor();
+
+    QRect targetRect() const;
+    QRect toWidget(const QRect &rect) const;
+    QPointF toFramebuffer(const QPointF &pos) const;
+    void forwardPointer(QMouseEvent *e);
     
 private:
     VncWidget *q;
@@ -22,12 +37,28 @@ private:
 public:
     QVncClient *client = nullptr;
     bool interactive = false;
+    int maximumFrameRate = 30;
+    bool scaledToFit = false;
+
+    QRegion damage;
+    QTimer frameTimer;
+    QElapsedTimer lastFrame;
+    // Where the cursor was last drawn, in framebuffer coordinates
+    QRect cursorRect;
+
+    // Downscaled framebuffer for scaled-to-fit, refreshed where damaged
+    QImage scaled;
+    QRegion scaledDamage;
 };
 
 VncWidget::Private::Private(VncWidget *parent)
     : q(parent)
 {
     q->setMouseTracking(true);
+    frameTimer.setSingleShot(true);
+    QObject::connect(&frameTimer, &QTimer::timeout, q, [this]() {
+        flushDamage();
+    });
 }
 
 void VncWidget::Private::paint(const QRect &rect)
@@ -38,16 +69,134 @@ void VncWidget::Private::paint(const QRect &rect)
         p.fillRect(rect, Qt::lightGray);
         return;
     }
-    
-    p.drawImage(rect, client->image(), rect);
 
-    // Draw cursor overlay
+    const QImage &image = client->image();
     const QImage &cursor = client->cursorImage();
-    if (!cursor.isNull()) {
-        const QPoint pos = client->cursorPos();
-        const QPoint hotspot = client->cursorHotspot();
-        p.drawImage(pos - hotspot, cursor);
+    const QPoint cursorPos = client->cursorPos() - client->cursorHotspot();
+    if (!scaledToFit || image.isNull()) {
+        p.drawImage(rect, image, rect);
+        // Draw cursor overlay
+        if (!cursor.isNull())
+            p.drawImage(cursorPos, cursor);
+        return;
+    }
+
+    const QRect target = targetRect();
+    if (scaled.size() != target.size()) {
+        scaled = image.scaled(target.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        scaledDamage = QRegion();
+    } else if (!scaledDamage.isEmpty()) {
+        // Rescale only the damaged areas, padded so filtering at their edges
+        // sees the neighbouring pixels
+        QPainter sp(&scaled);
+        const QRect bounds = image.rect();
+        for (const QRect &r : scaledDamage) {
+            const QRect source = r.adjusted(-1, -1, 1, 1) & bounds;
+            const QRect dest = toWidget(source).translated(-target.topLeft());
+            sp.drawImage(dest, image.copy(source).scaled(dest.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+        }
+        scaledDamage = QRegion();
+    }
+
+    for (const QRect &r : QRegion(rect) - target)
+        p.fillRect(r, q->palette().window());
+    p.drawImage(rect & target, scaled, (rect & target).translated(-target.topLeft()));
+    if (!cursor.isNull())
+        p.drawImage(toWidget(QRect(cursorPos, cursor.size())), cursor);
+}
+
+void VncWidget::Private::updateSize()
+{
+    if (!client)
+        return;
+    if (scaledToFit) {
+        q->setMinimumSize(1, 1);
+        q->setMaximumSize(QWIDGETSIZE_MAX, QWIDGETSIZE_MAX);
+    } else {
+        q->setFixedSize(client->framebufferWidth(), client->framebufferHeight());
+    }
+    scaled = QImage();
+    q->update();
+}
+
+void VncWidget::Private::addDamage(const QRect &rect)
+{
+    damage += rect;
+    if (frameTimer.isActive())
+        return;
+    const int interval = maximumFrameRate > 0 ? 1000 / maximumFrameRate : 0;
+    const qint64 sinceLast = lastFrame.isValid() ? lastFrame.elapsed() : interval;
+    frameTimer.start(int(qMax<qint64>(0, interval - sinceLast)));
+}
+
+void VncWidget::Private::flushDamage()
+{
+    lastFrame.start();
+    if (damage.isEmpty())
+        return;
+    if (scaledToFit) {
+        scaledDamage += damage;
+        QRegion widgetDamage;
+        for (const QRect &r : damage)
+            widgetDamage += toWidget(r.adjusted(-1, -1, 1, 1));
+        q->update(widgetDamage);
+    } else {
+        q->update(damage);
+    }
+    damage = QRegion();
+}
+
+void VncWidget::Private::updateCursor()
+{
+    const QImage &cursor = client->cursorImage();
+    const QRect rect = cursor.isNull() ? QRect()
+        : QRect(client->cursorPos() - client->cursorHotspot(), cursor.size());
+    if (rect == cursorRect)
+        return;
+    if (!cursorRect.isNull())
+        addDamage(cursorRect);
+    if (!rect.isNull())
+        addDamage(rect);
+    cursorRect = rect;
+}
+
+// The framebuffer scaled to the widget with its aspect ratio kept, centered
+QRect VncWidget::Private::targetRect() const
+{
+    const QSize size(client->framebufferWidth(), client->framebufferHeight());
+    if (!scaledToFit || size.isEmpty())
+        return QRect(QPoint(0, 0), size);
+    const QSize fitted = size.scaled(q->size(), Qt::KeepAspectRatio);
+    return QRect(QPoint((q->width() - fitted.width()) / 2, (q->height() - fitted.height()) / 2), fitted);
+}
+
+QRect VncWidget::Private::toWidget(const QRect &rect) const
+{
+    const QRect target = targetRect();
+    const qreal sx = qreal(target.width()) / qMax(1, client->framebufferWidth());
+    const qreal sy = qreal(target.height()) / qMax(1, client->framebufferHeight());
+    return QRectF(target.x() + rect.x() * sx, target.y() + rect.y() * sy,
+                  rect.width() * sx, rect.height() * sy).toAlignedRect();
+}
+
+QPointF VncWidget::Private::toFramebuffer(const QPointF &pos) const
+{
+    const QRect target = targetRect();
+    if (!scaledToFit || target.isEmpty())
+        return pos;
+    return QPointF((pos.x() - target.x()) * client->framebufferWidth() / target.width(),
+                   (pos.y() - target.y()) * client->framebufferHeight() / target.height());
+}
+
+void VncWidget::Private::forwardPointer(QMouseEvent *e)
+{
+    if (!scaledToFit) {
+        client->handlePointerEvent(e);
+        return;
     }
+    const QPointF pos = toFramebuffer(e->position());
+    QMouseEvent mapped(e->type(), pos, e->globalPosition(), e->button(), e->buttons(), e->modifiers());
+    client->handlePointerEvent(&mapped);
 }
 
 VncWidget::VncWidget(QWidget *parent)
@@ -75,13 +224,12 @@ void VncWidget::setClient(QVncClient *client)
     d->client = client;
     
     if (client) {
-        connect(client, &QVncClient::framebufferSizeChanged, this, [this](int width, int height) {
-            setFixedSize(width, height);
-            update();
+        connect(client, &QVncClient::framebufferSizeChanged, this, [this]() {
+            d->updateSize();
         });
         
         connect(client, &QVncClient::imageChanged, this, [this](const QRect &rect) {
-            update(rect);
+            d->addDamage(rect);
         });
         
         connect(client, &QVncClient::connectionStateChanged, this, [this](bool connected) {
@@ -91,10 +239,10 @@ void VncWidget::setClient(QVncClient *client)
         });
 
         connect(client, &QVncClient::cursorChanged, this, [this]() {
-            update();
+            d->updateCursor();
         });
         connect(client, &QVncClient::cursorPosChanged, this, [this]() {
-            update();
+            d->updateCursor();
         });
     }
     
@@ -111,6 +259,29 @@ void VncWidget::setInteractive(bool interactive)
     d->interactive = interactive;
 }
 
+int VncWidget::maximumFrameRate() const
+{
+    return d->maximumFrameRate;
+}
+
+void VncWidget::setMaximumFrameRate(int fps)
+{
+    d->maximumFrameRate = qMax(0, fps);
+}
+
+bool VncWidget::isScaledToFit() const
+{
+    return d->scaledToFit;
+}
+
+void VncWidget::setScaledToFit(bool scaled)
+{
+    if (d->scaledToFit == scaled)
+        return;
+    d->scaledToFit = scaled;
+    d->updateSize();
+}
+
 void VncWidget::keyPressEvent(QKeyEvent *e)
 {
     if (d->interactive && d->client) {
@@ -128,21 +299,21 @@ void VncWidget::keyReleaseEvent(QKeyEvent *e)
 void VncWidget::mousePressEvent(QMouseEvent *e)
 {
     if (d->interactive && d->client) {
-        d->client->handlePointerEvent(e);
+        d->forwardPointer(e);
     }
 }
 
 void VncWidget::mouseMoveEvent(QMouseEvent *e)
 {
     if (d->interactive && d->client) {
-        d->client->handlePointerEvent(e);
+        d->forwardPointer(e);
     }
 }
 
 void VncWidget::mouseReleaseEvent(QMouseEvent *e)
 {
     if (d->interactive && d->client) {
-        d->client->handlePointerEvent(e);
+        d->forwardPointer(e);
     }
 }
 
@@ -156,3 +327,10 @@ void VncWidget::paintEvent(QPaintEvent *e)
 {
     d->paint(e->rect());
 }
+
+void VncWidget::resizeEvent(QResizeEvent *e)
+{
+    // The cached downscale is rebuilt at the new size on the next paint
+    d->scaled = QImage();
+    QWidget::resizeEvent(e);
+}
@@ -10,11 +10,14 @@
 class QKeyEvent;
 class QMouseEvent;
 class QPaintEvent;
+class QResizeEvent;
 
 class VncWidget : public QWidget
 {
     Q_OBJECT
     Q_PROPERTY(QVncClient *client READ client WRITE setClient NOTIFY clientChanged)
+    Q_PROPERTY(int maximumFrameRate READ maximumFrameRate WRITE setMaximumFrameRate)
+    Q_PROPERTY(bool scaledToFit READ isScaledToFit WRITE setScaledToFit)
 
 public:
     explicit VncWidget(QWidget *parent = nullptr);
@@ -26,6 +29,14 @@ public:
     bool isInteractive() const;
     void setInteractive(bool interactive);
 
+    // Repaints per second, 0 for one repaint per framebuffer change
+    int maximumFrameRate() const;
+    void setMaximumFrameRate(int fps);
+
+    // Scales the framebuffer to the window instead of sizing the window to it
+    bool isScaledToFit() const;
+    void setScaledToFit(bool scaled);
+
 signals:
     void clientChanged(QVncClient *client);
     void closed();
@@ -38,6 +49,7 @@ protected:
     void mouseMoveEvent(QMouseEvent *e) override;
     void mouseReleaseEvent(QMouseEvent *e) override;
     void paintEvent(QPaintEvent *e) override;
+    void resizeEvent(QResizeEvent *e) override;
 
 private:
     class Private;